@@ -115,7 +115,13 @@ LOCAL_SRC_FILES := \
     utils/src/SignalHandler.cpp \
     utils/src/AudioHapticsInterface.cpp \
     utils/src/MetadataParser.cpp \
-    utils/src/PerfLock.cpp
+    utils/src/PerfLock.cpp \
+    utils/src/SoundModelCache.cpp \
+    utils/src/PalReactor.cpp \
+    utils/src/ThermalCalService.cpp \
+    utils/src/PalBinLog.cpp \
+    utils/src/PalThreadPolicy.cpp \
+    utils/src/PalBufferTuner.cpp
 
 LOCAL_HEADER_LIBRARIES := \
     libarpal_headers \
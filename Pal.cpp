@@ -252,6 +252,8 @@ int32_t pal_stream_open(struct pal_stream_attributes *attributes,
 
     PAL_INFO(LOG_TAG, "Enter, stream type:%d", attributes->type);
     kpiEnqueue(__func__, true);
+    perflock.setStreamContext(attributes->type,
+                              (devices && no_of_devices) ? devices[0].id : PAL_DEVICE_NONE);
 #ifdef SOC_PERIPHERAL_PROT
     if (ResourceManager::isTZSecureZone) {
         PAL_DBG(LOG_TAG, "In secure zone, so stop the usecase");
@@ -410,6 +412,8 @@ int32_t pal_stream_start(pal_stream_handle_t *stream_handle)
 
     s->getStreamAttributes(&sAttr);
     s->getAssociatedDevices(palDevices);
+    perflock.setStreamContext(sAttr.type, palDevices.empty() ?
+                              PAL_DEVICE_NONE : palDevices[0]->getSndDeviceId());
     if (sAttr.type == PAL_STREAM_VOICE_UI)
         rm->handleDeferredSwitch();
 
@@ -682,7 +686,7 @@ int32_t pal_stream_set_volume(pal_stream_handle_t *stream_handle,
     rm->unlockActiveStream();
 
     s->lockStreamMutex();
-    status = s->setVolume(volume);
+    status = s->setVolumeAsync(volume, NULL);
     s->unlockStreamMutex();
 
     rm->lockActiveStream();
@@ -703,6 +707,8 @@ int32_t pal_stream_set_mute(pal_stream_handle_t *stream_handle, bool state)
 {
     Stream *s = NULL;
     std::shared_ptr<ResourceManager> rm = NULL;
+    pal_stream_direction_t dir = PAL_AUDIO_OUTPUT;
+    uint64_t fence = 0;
     int status = 0;
 
     if (!stream_handle) {
@@ -736,7 +742,10 @@ int32_t pal_stream_set_mute(pal_stream_handle_t *stream_handle, bool state)
         goto exit;
     }
     rm->unlockActiveStream();
-    status = s->mute(state);
+    status = s->muteAsync(state, &fence);
+    /* a capture stream must be muted by the time the caller returns */
+    if (0 == status && fence && !s->getStreamDirection(&dir) && dir != PAL_AUDIO_OUTPUT)
+        status = s->waitParamUpdate(fence, PARAM_UPDATE_WAIT_MS);
 
     rm->lockActiveStream();
     rm->decreaseStreamUserCounter(s);
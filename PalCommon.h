@@ -44,28 +44,50 @@
 #define PAL_LOG_INFO            (0x2) /**< info message, additional info to support debug */
 #define PAL_LOG_DBG             (0x4) /**< debug message, required at minimum for debug.*/
 #define PAL_LOG_VERBOSE         (0x8)/**< verbose message, useful primarily to help developers debug low-level code */
+#define PAL_LOG_BINARY          (0x10)/**< INFO/DBG/VERBOSE go to the PalBinLog ring instead of logd */
+
+/* levels left out of PAL_LOG_COMPILE_LVL are compiled out entirely */
+#ifndef PAL_LOG_COMPILE_LVL
+#define PAL_LOG_COMPILE_LVL     (PAL_LOG_ERR | PAL_LOG_INFO | PAL_LOG_DBG | PAL_LOG_VERBOSE)
+#endif
+
+#define PAL_LOG_ENABLED(lvl)    ((PAL_LOG_COMPILE_LVL & (lvl)) && (pal_log_lvl & (lvl)))
 
 extern uint32_t pal_log_lvl;
 
+#ifdef __cplusplus
+#include "PalBinLog.h"
+
+#define PAL_LOG_BIN(lvl, alog, arg, ...)                                   \
+    if ((pal_log_lvl & PAL_LOG_BINARY) && PalBinLog::ready()) {           \
+        PalBinLog::record(lvl, LOG_TAG, __func__, __LINE__, arg, ##__VA_ARGS__); \
+    } else {                                                          \
+        alog("%s: %d: "  arg, __func__, __LINE__, ##__VA_ARGS__);     \
+    }
+#else
+#define PAL_LOG_BIN(lvl, alog, arg, ...)                                   \
+    alog("%s: %d: "  arg, __func__, __LINE__, ##__VA_ARGS__);
+#endif
+
 #define PAL_FATAL(log_tag, arg,...)                                       \
-    if (pal_log_lvl & PAL_LOG_ERR) {                              \
+    if (PAL_LOG_ENABLED(PAL_LOG_ERR)) {                               \
         ALOGE("%s: %d: "  arg, __func__, __LINE__, ##__VA_ARGS__);\
         abort();                                                  \
     }
 
 #define PAL_ERR(log_tag, arg,...)                                          \
-    if (pal_log_lvl & PAL_LOG_ERR) {                              \
+    if (PAL_LOG_ENABLED(PAL_LOG_ERR)) {                               \
         ALOGE("%s: %d: "  arg, __func__, __LINE__, ##__VA_ARGS__);\
     }
 #define PAL_DBG(log_tag,arg,...)                                           \
-    if (pal_log_lvl & PAL_LOG_DBG) {                               \
-        ALOGD("%s: %d: "  arg, __func__, __LINE__, ##__VA_ARGS__); \
+    if (PAL_LOG_ENABLED(PAL_LOG_DBG)) {                               \
+        PAL_LOG_BIN(PAL_LOG_DBG, ALOGD, arg, ##__VA_ARGS__)            \
     }
 #define PAL_INFO(log_tag,arg,...)                                         \
-    if (pal_log_lvl & PAL_LOG_INFO) {                             \
-        ALOGI("%s: %d: "  arg, __func__, __LINE__, ##__VA_ARGS__);\
+    if (PAL_LOG_ENABLED(PAL_LOG_INFO)) {                              \
+        PAL_LOG_BIN(PAL_LOG_INFO, ALOGI, arg, ##__VA_ARGS__)           \
     }
 #define PAL_VERBOSE(log_tag,arg,...)                                      \
-    if (pal_log_lvl & PAL_LOG_VERBOSE) {                          \
-        ALOGV("%s: %d: "  arg, __func__, __LINE__, ##__VA_ARGS__);\
+    if (PAL_LOG_ENABLED(PAL_LOG_VERBOSE)) {                           \
+        PAL_LOG_BIN(PAL_LOG_VERBOSE, ALOGV, arg, ##__VA_ARGS__)        \
     }
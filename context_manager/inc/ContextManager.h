@@ -35,7 +35,8 @@
 
 #include <vector>
 #include <thread>
-#include <queue>
+#include <deque>
+#include <set>
 #include <condition_variable>
 #include <PalApi.h>
 #include <PalCommon.h>
@@ -43,6 +44,12 @@
 #include "ACDPlatformInfo.h"
 #include "SoundTriggerPlatformInfo.h"
 
+/* see_id of commands which must run with no other command in flight */
+#define CM_CMD_ALL_CLIENTS 0xFFFFFFFF
+#define CM_CMD_WORKERS 3
+/* teardown and SSR log running commands which take longer than this */
+#define CM_CMD_DRAIN_TIMEOUT_MS 2000
+
 enum PCM_DATA_EFFECT {
     PCM_DATA_EFFECT_RAW = 1,
     PCM_DATA_EFFECT_NS = 2,
@@ -65,9 +72,9 @@ public:
     Usecase(uint32_t usecase_id);
     virtual ~Usecase();
     uint32_t GetUseCaseID();
-    int32_t Open();
-    int32_t Start();
-    int32_t StopAndClose();
+    virtual int32_t Open();
+    virtual int32_t Start();
+    virtual int32_t StopAndClose();
 
     int32_t GetModuleIIDs(std::vector<int32_t> tags,
         std::map<int32_t, std::vector<uint32_t>> &tag_miid_map);
@@ -117,17 +124,53 @@ public:
     int32_t GetAckDataOnSuccessfullStart(uint32_t *size, void *data);
 };
 
+/*
+ * PCM data graphs are shared: a client requesting the same usecase, data
+ * type, buffering and device config as a running graph is attached to it
+ * and acked with the same module iids instead of opening another graph.
+ * Clients share the module endpoints as they are, PAL keeps no per-client
+ * read position; consumers of the same module must coordinate their reads.
+ */
+struct PCMDataCapture {
+    pal_stream_handle_t *stream;
+    uint32_t usecase_id;
+    uint32_t pcm_data_type;
+    uint32_t pcm_data_buffering;
+    pal_device_id_t device_id;
+    uint32_t sample_rate;
+    uint32_t bit_width;
+    uint32_t channels;
+    uint32_t refs;
+    bool started;
+    /* the owner is applying config or starting, with captures_mtx dropped */
+    bool starting;
+};
+
 class UsecasePCMData : public Usecase
 {
 private:
     std::vector<int32_t> tags;
     uint32_t pcm_data_type;
     uint32_t pcm_data_buffering;
+    PCMDataCapture *capture;
+
+    static std::mutex captures_mtx;
+    static std::vector<PCMDataCapture *> captures;
+
+    int32_t ApplyConfig();
+    int32_t OpenCapture(bool started);
+    // Below functions need to be called with captures_mtx held
+    bool MatchesCapture_l(const PCMDataCapture *cap);
+    void SetCaptureConfig_l(PCMDataCapture *cap);
+    bool DetachCapture_l();
 public:
     UsecasePCMData(uint32_t usecase_id);
     ~UsecasePCMData();
     int32_t SetUseCaseData(uint32_t size, void *data);
+    int32_t Open();
     int32_t Configure();
+    int32_t Start();
+    int32_t StopAndClose();
 
     // caller can allocate sufficient memory the first time to avoid
     // calling this api twice. Size, will be updated to actual size;
@@ -158,9 +201,7 @@ class see_client
 private:
     uint32_t see_id;
     std::map<uint32_t, Usecase*> usecases;
-
-protected:
-    static std::mutex see_client_mutex;
+    std::mutex see_client_mutex;
 
 public:
     see_client(uint32_t id);
@@ -180,6 +221,12 @@ public:
     virtual ~RequestCommand();
 
     virtual int32_t Process(ContextManager& cm) = 0;
+    /* commands with the same see_id run in queue order, one at a time */
+    virtual uint32_t GetSeeId() { return CM_CMD_ALL_CLIENTS; }
+    /* true if this queued command can be dropped in favour of cmd */
+    virtual bool IsSupersededBy(RequestCommand *cmd) { return false; }
+    /* called before the queued cmd, superseded by this one, is dropped */
+    virtual void Supersede(RequestCommand *cmd) { }
 };
 
 class CommandRegister : public RequestCommand {
@@ -188,17 +235,23 @@ public:
     ~CommandRegister();
 
     int32_t Process(ContextManager& cm);
+    uint32_t GetSeeId() { return see_sensor_iid; }
+    bool IsSupersededBy(RequestCommand *cmd);
+    void Supersede(RequestCommand *cmd);
 private:
     uint32_t see_sensor_iid;
     uint32_t usecase_id;
     uint32_t payload_size;
     uint32_t *payload;
+    /* queued requests this one replaced, each still owed an ack */
+    uint32_t superseded_count;
 };
 
 class CommandDeregister : public RequestCommand {
 public:
     CommandDeregister(uint32_t event_id, uint32_t* event_data);
     int32_t Process(ContextManager& cm);
+    uint32_t GetSeeId() { return see_sensor_iid; }
 private:
     uint32_t see_sensor_iid;
     uint32_t usecase_id;
@@ -208,6 +261,7 @@ class CommandGetContextIDs : public RequestCommand {
 public:
     CommandGetContextIDs(uint32_t event_id, uint32_t* event_data);
     int32_t Process(ContextManager& cm);
+    uint32_t GetSeeId() { return see_sensor_iid; }
 private:
     uint32_t see_sensor_iid;
 };
@@ -229,12 +283,17 @@ class ContextManager
 {
 private:
     std::map<uint32_t, see_client *> see_clients;
+    std::mutex see_clients_mtx;
     pal_stream_handle_t *proxy_stream;
     bool exit_cmd_thread_;
     std::condition_variable request_queue_cv;
+    /* guards the queue and the dispatch state below, never held by Process() */
     std::mutex request_queue_mtx;
-    std::thread cmd_thread_;
-    std::queue<RequestCommand *> request_cmd_queue;
+    std::vector<std::thread> cmd_threads_;
+    std::deque<RequestCommand *> request_cmd_queue;
+    std::set<uint32_t> busy_see_ids_;
+    uint32_t running_cmds_;
+    bool exclusive_cmd_running_;
 
     see_client* SEE_Client_CreateIf_And_Get(uint32_t see_id);
     see_client * SEE_Client_Get_Existing(uint32_t see_id);
@@ -244,6 +303,8 @@ private:
     void DestroyCommandProcessingThread();
     void CloseAll();
     static void CommandThreadRunner(ContextManager& cm);
+    RequestCommand *PopRunnableCommand_l();
+    void DropQueuedCommands();
     int32_t build_and_send_register_ack(Usecase *uc, uint32_t see_id, uint32_t uc_id);
 
 public:
@@ -258,8 +319,9 @@ public:
     int32_t ssrDownHandler();
     int32_t ssrUpHandler();
     int32_t process_deregister_request(uint32_t see_id, uint32_t usecase_id);
+    /* acks is the number of requests this one answers, see CommandRegister */
     int32_t process_register_request(uint32_t see_id, uint32_t usecase, uint32_t payload_size,
-        void *payload);
+        void *payload, uint32_t acks = 1);
     int32_t process_close_all();
 
     int32_t send_asps_response(uint32_t param_id, pal_param_payload *payload);
@@ -44,14 +44,13 @@
 #define ACKDATA_DEFAULT_SIZE 1024
 #define PAL_ALIGN_8BYTE(x) (((x) + 7) & (~7))
 
-std::mutex see_client::see_client_mutex;
-
 int32_t ContextManager::process_register_request(uint32_t see_id, uint32_t usecase_id, uint32_t size,
-    void *payload)
+    void *payload, uint32_t acks)
 {
     int32_t rc = 0;
     Usecase *uc = NULL;
     see_client *seeclient = NULL;
+    uint32_t acked = 0;
 
     PAL_VERBOSE(LOG_TAG, "Enter see_id:%d, usecase_id:0x%x, payload_size:%d", see_id, usecase_id, size);
 
@@ -120,16 +119,20 @@ int32_t ContextManager::process_register_request(uint32_t see_id, uint32_t useca
         }
     }
 
-    rc = build_and_send_register_ack(uc, see_id, usecase_id);
-    if (rc) {
-        PAL_ERR(LOG_TAG, "Error:%d, Failed to get AckData for usecase:0x%x for see_client:%d", rc, usecase_id, see_id);
-        goto exit;
+    // requests coalesced into this one get the same ack, in request order
+    for (acked = 0; acked < acks; acked++) {
+        rc = build_and_send_register_ack(uc, see_id, usecase_id);
+        if (rc) {
+            PAL_ERR(LOG_TAG, "Error:%d, Failed to get AckData for usecase:0x%x for see_client:%d", rc, usecase_id, see_id);
+            goto exit;
+        }
     }
 
 exit:
-    // send basic ack with failure.
+    // send basic ack with failure, to every request not acked yet.
     if (rc) {
-        send_asps_basic_response(rc, EVENT_ID_ASPS_SENSOR_REGISTER_REQUEST, see_id);
+        for (; acked < acks; acked++)
+            send_asps_basic_response(rc, EVENT_ID_ASPS_SENSOR_REGISTER_REQUEST, see_id);
     }
     seeclient->unlock_see_client();
     PAL_VERBOSE(LOG_TAG, "Exit rc:%d", rc);
@@ -321,6 +324,10 @@ exit:
 ContextManager::ContextManager()
 {
     PAL_VERBOSE(LOG_TAG, "Enter");
+    proxy_stream = NULL;
+    exit_cmd_thread_ = false;
+    running_cmds_ = 0;
+    exclusive_cmd_running_ = false;
     PAL_VERBOSE(LOG_TAG, "Exit");
 }
 
@@ -361,6 +368,7 @@ void ContextManager::DeInit()
 {
     PAL_VERBOSE(LOG_TAG, "Enter");
 
+    DropQueuedCommands();
     CloseAll();
     StopAndCloseProxyStream();
     DestroyCommandProcessingThread();
@@ -368,21 +376,35 @@ void ContextManager::DeInit()
     PAL_VERBOSE(LOG_TAG, "Exit");
 }
 
+/*
+ * Drops pending commands and waits for the running ones to return. A command
+ * which takes longer than CM_CMD_DRAIN_TIMEOUT_MS is logged, then waited for.
+ */
+void ContextManager::DropQueuedCommands()
+{
+    std::unique_lock<std::mutex> lck(request_queue_mtx);
+
+    while (!request_cmd_queue.empty()) {
+        delete request_cmd_queue.front();
+        request_cmd_queue.pop_front();
+    }
+    if (!request_queue_cv.wait_for(lck, std::chrono::milliseconds(CM_CMD_DRAIN_TIMEOUT_MS),
+                                   [this] { return running_cmds_ == 0; })) {
+        PAL_ERR(LOG_TAG, "%u commands still running after %d ms", running_cmds_,
+                CM_CMD_DRAIN_TIMEOUT_MS);
+        // CloseAll frees the clients and usecases those commands work on
+        request_queue_cv.wait(lck, [this] { return running_cmds_ == 0; });
+    }
+}
+
 int32_t ContextManager::ssrDownHandler()
 {
     int32_t rc = 0;
-    std::unique_lock<std::mutex> lck(request_queue_mtx, std::defer_lock);
     PAL_VERBOSE(LOG_TAG, "Enter");
 
+    DropQueuedCommands();
     this->CloseAll();
 
-    lck.lock();
-    while (!request_cmd_queue.empty()) {
-        free(request_cmd_queue.front());
-        request_cmd_queue.pop();
-    }
-    lck.unlock();
-
     PAL_VERBOSE(LOG_TAG, "Exit rc %d", rc);
     return rc;
 }
@@ -403,9 +425,31 @@ int32_t ContextManager::StreamProxyCallback (pal_stream_handle_t *stream_handle,
     ContextManager* cm = ((ContextManager*)cookie);
 
     PAL_VERBOSE(LOG_TAG, "Enter");
-    std::unique_lock<std::mutex> lck(cm->request_queue_mtx);
     request_command = RequestCommandFactory::RequestCommandCreate(event_id, event_data);
-    cm->request_cmd_queue.push(request_command);
+    if (!request_command)
+        return 0;
+
+    std::unique_lock<std::mutex> lck(cm->request_queue_mtx);
+    /*
+     * A client's newest queued request for the same usecase replaces an
+     * older one which has not started yet. The replacement acks both, with
+     * its own outcome and module iids.
+     */
+    for (auto it = cm->request_cmd_queue.rbegin(); it != cm->request_cmd_queue.rend(); ++it) {
+        if ((*it)->GetSeeId() != request_command->GetSeeId())
+            continue;
+        if ((*it)->IsSupersededBy(request_command)) {
+            PAL_DBG(LOG_TAG, "coalescing request for see_client:%d",
+                    request_command->GetSeeId());
+            request_command->Supersede(*it);
+            delete *it;
+            *it = request_command;
+            request_command = NULL;
+        }
+        break;
+    }
+    if (request_command)
+        cm->request_cmd_queue.push_back(request_command);
     cm->request_queue_cv.notify_one();
 
     PAL_VERBOSE(LOG_TAG, "Exit");
@@ -418,6 +462,7 @@ void ContextManager::CloseAll()
     see_client *see = NULL;
 
     PAL_VERBOSE(LOG_TAG, "Enter");
+    std::lock_guard<std::mutex> lck(see_clients_mtx);
     for (auto it_see_client = this->see_clients.begin(); it_see_client != this->see_clients.cend();) {
         see = it_see_client->second;
         PAL_VERBOSE(LOG_TAG, "Calling CloseAllUsecases for see_client:%d", see->Get_SEE_ID());
@@ -488,9 +533,43 @@ int32_t ContextManager::StopAndCloseProxyStream()
     return rc;
 }
 
+/*
+ * Returns the oldest command whose see client has nothing in flight. A
+ * CM_CMD_ALL_CLIENTS command waits until all running commands returned
+ * and holds back everything queued after it until it is done.
+ */
+RequestCommand *ContextManager::PopRunnableCommand_l()
+{
+    RequestCommand *cmd = NULL;
+    uint32_t see_id;
+
+    if (exclusive_cmd_running_)
+        return NULL;
+
+    for (auto it = request_cmd_queue.begin(); it != request_cmd_queue.end(); ++it) {
+        see_id = (*it)->GetSeeId();
+        if (see_id == CM_CMD_ALL_CLIENTS) {
+            if (running_cmds_ != 0)
+                return NULL;
+            exclusive_cmd_running_ = true;
+        } else if (busy_see_ids_.count(see_id)) {
+            continue;
+        } else {
+            busy_see_ids_.insert(see_id);
+        }
+        cmd = *it;
+        request_cmd_queue.erase(it);
+        running_cmds_++;
+        break;
+    }
+
+    return cmd;
+}
+
 void ContextManager::CommandThreadRunner(ContextManager& cm)
 {
     RequestCommand *request_command;
+    uint32_t see_id;
     int32_t rc = 0;
 
     PAL_VERBOSE(LOG_TAG, "Entering CommandThreadRunner");
@@ -498,25 +577,31 @@ void ContextManager::CommandThreadRunner(ContextManager& cm)
     std::unique_lock<std::mutex> lck(cm.request_queue_mtx);
     while (!cm.exit_cmd_thread_) {
         // wait until we have a command to process.
-        if (cm.request_cmd_queue.empty()) {
+        request_command = cm.PopRunnableCommand_l();
+        if (!request_command) {
             cm.request_queue_cv.wait(lck);
-            if (cm.exit_cmd_thread_) {
+            if (cm.exit_cmd_thread_)
                 PAL_DBG(LOG_TAG, "Received exit request");
-                continue;
-            }
+            continue;
         }
 
-        if (!cm.request_cmd_queue.empty()) {
-            request_command = cm.request_cmd_queue.front();
-            cm.request_cmd_queue.pop();
+        see_id = request_command->GetSeeId();
+        lck.unlock();
 
-            rc = request_command->Process(cm);
-            if (rc) {
-                PAL_ERR(LOG_TAG, "Error:%d failed to process request", rc);
-            }
-
-            free(request_command);
+        rc = request_command->Process(cm);
+        if (rc) {
+            PAL_ERR(LOG_TAG, "Error:%d failed to process request", rc);
         }
+        delete request_command;
+
+        lck.lock();
+        cm.running_cmds_--;
+        if (see_id == CM_CMD_ALL_CLIENTS)
+            cm.exclusive_cmd_running_ = false;
+        else
+            cm.busy_see_ids_.erase(see_id);
+        // may unblock a queued command of this client, an exclusive one or a drain
+        cm.request_queue_cv.notify_all();
     }
     PAL_VERBOSE(LOG_TAG, "Exiting CommandThreadRunner");
 }
@@ -528,7 +613,8 @@ int32_t ContextManager::CreateCommandProcessingThread()
     PAL_VERBOSE(LOG_TAG, "Enter");
 
     exit_cmd_thread_ = false;
-    cmd_thread_ = std::thread(CommandThreadRunner, std::ref(*this));
+    for (int i = 0; i < CM_CMD_WORKERS; i++)
+        cmd_threads_.emplace_back(CommandThreadRunner, std::ref(*this));
 
     PAL_VERBOSE(LOG_TAG, "Exit rc: %d", rc);
     return rc;
@@ -540,13 +626,19 @@ void ContextManager::DestroyCommandProcessingThread()
 
     PAL_VERBOSE(LOG_TAG, "Enter");
 
-    exit_cmd_thread_ = true;
-    request_queue_cv.notify_all();
+    {
+        std::lock_guard<std::mutex> lck(request_queue_mtx);
+        exit_cmd_thread_ = true;
+        request_queue_cv.notify_all();
+    }
 
-    if (cmd_thread_.joinable()) {
-        PAL_DBG(LOG_TAG, "Join cmd_thread_ thread");
-        cmd_thread_.join();
+    for (auto &cmd_thread : cmd_threads_) {
+        if (cmd_thread.joinable()) {
+            PAL_DBG(LOG_TAG, "Join cmd thread");
+            cmd_thread.join();
+        }
     }
+    cmd_threads_.clear();
 
     PAL_VERBOSE(LOG_TAG, "Exit rc:%d", rc);
 }
@@ -611,6 +703,7 @@ CommandRegister::CommandRegister(uint32_t event_id, uint32_t* event_data) :
     this->payload_size = data->payload_size;
     this->usecase_id = data->usecase_id;
     this->see_sensor_iid = data->see_sensor_iid;
+    this->superseded_count = 0;
 
     this->payload = (uint32_t *) calloc (1, this->payload_size);
     if (!this->payload) {
@@ -630,14 +723,31 @@ CommandRegister::~CommandRegister()
     PAL_VERBOSE(LOG_TAG, "Exit");
 }
 
+bool CommandRegister::IsSupersededBy(RequestCommand *cmd)
+{
+    CommandRegister *reg = dynamic_cast<CommandRegister *>(cmd);
+
+    return reg && reg->see_sensor_iid == see_sensor_iid &&
+           reg->usecase_id == usecase_id;
+}
+
+void CommandRegister::Supersede(RequestCommand *cmd)
+{
+    CommandRegister *reg = dynamic_cast<CommandRegister *>(cmd);
+
+    if (reg)
+        this->superseded_count += reg->superseded_count + 1;
+}
+
 int32_t CommandRegister::Process(ContextManager& cm)
 {
     int32_t rc = 0;
 
     PAL_VERBOSE(LOG_TAG, "Enter");
 
+    // the replaced requests are answered with the outcome of this one
     rc = cm.process_register_request(this->see_sensor_iid, this->usecase_id,
-        this->payload_size, this->payload);
+        this->payload_size, this->payload, this->superseded_count + 1);
     PAL_VERBOSE(LOG_TAG, "Exit rc:%d", rc);
     return rc;
 }
@@ -791,6 +901,7 @@ see_client* ContextManager::SEE_Client_CreateIf_And_Get(uint32_t see_id)
 
     PAL_VERBOSE(LOG_TAG, "Enter seeid:%d", see_id);
 
+    std::lock_guard<std::mutex> lck(see_clients_mtx);
     it = see_clients.find(see_id);
     if (it != see_clients.end()) {
         client = it->second;
@@ -811,6 +922,7 @@ see_client* ContextManager::SEE_Client_Get_Existing(uint32_t see_id)
 
     PAL_VERBOSE(LOG_TAG, "Enter seeid:%d", see_id);
 
+    std::lock_guard<std::mutex> lck(see_clients_mtx);
     it = see_clients.find(see_id);
     if (it != see_clients.end()) {
         client = it->second;
@@ -1302,10 +1414,14 @@ exit:
     return rc;
 }
 
+std::mutex UsecasePCMData::captures_mtx;
+std::vector<PCMDataCapture *> UsecasePCMData::captures;
+
 UsecasePCMData::UsecasePCMData(uint32_t usecase_id) : Usecase(usecase_id)
 {
     PAL_VERBOSE(LOG_TAG, "Enter usecase:0x%x", usecase_id);
 
+    this->capture = NULL;
     this->stream_attributes->type = PAL_STREAM_SENSOR_PCM_DATA;
     this->stream_attributes->direction = PAL_AUDIO_INPUT;
     this->no_of_devices = 1;
@@ -1366,7 +1482,7 @@ exit:
     return rc;
 }
 
-int32_t UsecasePCMData::Configure()
+int32_t UsecasePCMData::ApplyConfig()
 {
     int32_t rc = 0;
     pal_param_payload *pal_param = NULL;
@@ -1407,6 +1523,217 @@ exit:
     return rc;
 }
 
+bool UsecasePCMData::MatchesCapture_l(const PCMDataCapture *cap)
+{
+    return cap->usecase_id == this->usecase_id &&
+           cap->pcm_data_type == this->pcm_data_type &&
+           cap->pcm_data_buffering == this->pcm_data_buffering &&
+           cap->device_id == this->pal_devices[0].id &&
+           cap->sample_rate == this->pal_devices[0].config.sample_rate &&
+           cap->bit_width == this->pal_devices[0].config.bit_width &&
+           cap->channels == this->pal_devices[0].config.ch_info.channels;
+}
+
+void UsecasePCMData::SetCaptureConfig_l(PCMDataCapture *cap)
+{
+    cap->usecase_id = this->usecase_id;
+    cap->pcm_data_type = this->pcm_data_type;
+    cap->pcm_data_buffering = this->pcm_data_buffering;
+    cap->device_id = this->pal_devices[0].id;
+    cap->sample_rate = this->pal_devices[0].config.sample_rate;
+    cap->bit_width = this->pal_devices[0].config.bit_width;
+    cap->channels = this->pal_devices[0].config.ch_info.channels;
+}
+
+/* returns true if this was the last reader and the graph must be closed */
+bool UsecasePCMData::DetachCapture_l()
+{
+    PCMDataCapture *cap = this->capture;
+
+    if (!cap)
+        return this->pal_stream != NULL;
+
+    this->capture = NULL;
+    if (--cap->refs > 0) {
+        PAL_DBG(LOG_TAG, "usecase:0x%x leaves shared graph, %d readers left",
+                this->usecase_id, cap->refs);
+        this->pal_stream = NULL;
+        return false;
+    }
+
+    captures.erase(std::find(captures.begin(), captures.end(), cap));
+    delete cap;
+    return true;
+}
+
+/* opens a graph of our own and makes it available for sharing */
+int32_t UsecasePCMData::OpenCapture(bool started)
+{
+    int32_t rc = 0;
+    PCMDataCapture *cap = NULL;
+
+    rc = Usecase::Open();
+    if (rc)
+        goto exit;
+
+    // without an entry the graph is simply not shared
+    cap = new (std::nothrow) PCMDataCapture();
+    if (!cap) {
+        PAL_ERR(LOG_TAG, "failed to allocate capture for usecase:0x%x", this->usecase_id);
+        goto exit;
+    }
+
+    {
+        std::lock_guard<std::mutex> lck(captures_mtx);
+        cap->stream = this->pal_stream;
+        cap->refs = 1;
+        cap->started = started;
+        SetCaptureConfig_l(cap);
+        captures.push_back(cap);
+        this->capture = cap;
+    }
+
+exit:
+    return rc;
+}
+
+int32_t UsecasePCMData::Open()
+{
+    int32_t rc = 0;
+
+    PAL_VERBOSE(LOG_TAG, "Enter usecase:0x%x", this->usecase_id);
+
+    {
+        std::lock_guard<std::mutex> lck(captures_mtx);
+        // a graph still being configured by its owner may yet fail, do not join it
+        for (PCMDataCapture *cap : captures) {
+            if (cap->started && !cap->starting && MatchesCapture_l(cap)) {
+                cap->refs++;
+                this->capture = cap;
+                this->pal_stream = cap->stream;
+                PAL_DBG(LOG_TAG, "usecase:0x%x joins running graph, %d readers",
+                        this->usecase_id, cap->refs);
+                goto exit;
+            }
+        }
+    }
+
+    rc = OpenCapture(false);
+
+exit:
+    PAL_VERBOSE(LOG_TAG, "Exit rc:%d", rc);
+    return rc;
+}
+
+int32_t UsecasePCMData::Configure()
+{
+    int32_t rc = 0;
+    bool close = false;
+
+    PAL_VERBOSE(LOG_TAG, "Enter usecase:0x%x", this->usecase_id);
+
+    std::unique_lock<std::mutex> lck(captures_mtx);
+    if (!this->capture || this->capture->refs == 1) {
+        // nobody joins while starting is set, so the lock can be dropped for PAL
+        if (this->capture)
+            this->capture->starting = true;
+        lck.unlock();
+        rc = ApplyConfig();
+        lck.lock();
+        if (this->capture) {
+            if (!rc)
+                SetCaptureConfig_l(this->capture);
+            this->capture->starting = false;
+        }
+        goto exit;
+    }
+
+    // shared graph already carries this config
+    if (MatchesCapture_l(this->capture))
+        goto exit;
+
+    // config changed on re-register, move to a graph of our own
+    PAL_DBG(LOG_TAG, "usecase:0x%x config changed, leaving shared graph", this->usecase_id);
+    close = DetachCapture_l();
+    lck.unlock();
+    if (close)
+        Usecase::StopAndClose();
+    this->pal_stream = NULL;
+
+    rc = Usecase::Open();
+    if (rc)
+        goto exit;
+
+    rc = ApplyConfig();
+    if (!rc)
+        rc = Usecase::Start();
+    if (rc) {
+        Usecase::StopAndClose();
+        this->pal_stream = NULL;
+        goto exit;
+    }
+
+    lck.lock();
+    this->capture = new (std::nothrow) PCMDataCapture();
+    if (this->capture) {
+        this->capture->stream = this->pal_stream;
+        this->capture->refs = 1;
+        this->capture->started = true;
+        SetCaptureConfig_l(this->capture);
+        captures.push_back(this->capture);
+    }
+
+exit:
+    PAL_VERBOSE(LOG_TAG, "Exit rc:%d", rc);
+    return rc;
+}
+
+int32_t UsecasePCMData::Start()
+{
+    int32_t rc = 0;
+
+    PAL_VERBOSE(LOG_TAG, "Enter usecase:0x%x", this->usecase_id);
+
+    std::unique_lock<std::mutex> lck(captures_mtx);
+    if (this->capture && this->capture->started)
+        goto exit;
+
+    if (this->capture)
+        this->capture->starting = true;
+    lck.unlock();
+    rc = Usecase::Start();
+    lck.lock();
+    if (this->capture) {
+        if (!rc)
+            this->capture->started = true;
+        this->capture->starting = false;
+    }
+
+exit:
+    PAL_VERBOSE(LOG_TAG, "Exit rc:%d", rc);
+    return rc;
+}
+
+int32_t UsecasePCMData::StopAndClose()
+{
+    int32_t rc = 0;
+    bool close = false;
+
+    PAL_VERBOSE(LOG_TAG, "Enter usecase:0x%x", this->usecase_id);
+
+    {
+        std::lock_guard<std::mutex> lck(captures_mtx);
+        close = DetachCapture_l();
+    }
+    if (close) {
+        rc = Usecase::StopAndClose();
+        this->pal_stream = NULL;
+    }
+
+    PAL_VERBOSE(LOG_TAG, "Exit rc:%d", rc);
+    return rc;
+}
+
 int32_t UsecasePCMData::SetUseCaseData(uint32_t size, void *data)
 {
     int rc = 0;
@@ -74,6 +74,8 @@
 #include <thread>
 #include<vector>
 #include "apm_api.h"
+#include "PalReactor.h"
+#include "ThermalCalService.h"
 
 class Device;
 
@@ -157,6 +159,13 @@ protected :
     static struct pal_device_info cps_device;
     void *viCustomPayload;
     size_t viCustomPayloadSize;
+    /* VI TX graph stopped but still prepared after the last speaker stop */
+    static bool viTxSuspended;
+    static SpeakerProtection *viTxSuspendedOwner;
+    static std::string viTxSuspendedDev;
+    static int viTxSuspendedMode;
+    static uint32_t viTxSuspendGen;
+    static PalReactor::TimerId viTxIdleTimer;
 
 private :
 
@@ -169,6 +178,7 @@ public:
     static std::mutex calibrationMutex;
     void spkrCalibrationThread();
     int getSpeakerTemperature(int spkr_pos);
+    ThermalCalService::TempCtrlNames getSpkrTempCtrlNames(int spkr_pos);
     void spkrCalibrateWait();
     int spkrStartCalibration();
     int viTxSetupThreadLoop();
@@ -201,6 +211,13 @@ public:
     int32_t getCalibrationData(void **param);
     int32_t getFTMParameter(void **param);
     void disconnectFeandBe(std::vector<int> pcmDevIds, std::string backEndName);
+    static bool loadR0T0(vi_r0t0_cfg_t r0t0Array[], int channels);
+    // Below functions need to be called with calibrationMutex held
+    void closeViTxPath_l(char *sndDevName);
+    void suspendViTx_l(char *sndDevName);
+    bool resumeSuspendedViTx_l(char *sndDevName);
+    static void closeSuspendedViTx_l();
+    static void onViTxIdleTimeout(uint32_t gen);
 
 };
 
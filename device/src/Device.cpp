@@ -368,11 +368,12 @@ int Device::getDeviceAttributes(struct pal_device *dattr, Stream* streamHandle)
         return  -EINVAL;
     }
 
+    // copied under the lock, setDeviceAttributes may be rewriting it
+    mDeviceMutex.lock();
     ar_mem_cpy(dattr, sizeof(struct pal_device),
             &deviceAttr, sizeof(struct pal_device));
 
     /* overwrite custom key if stream is specified */
-    mDeviceMutex.lock();
     if (streamHandle != NULL) {
         if (mStreamDevAttr.empty()) {
             PAL_DBG(LOG_TAG, "no device attr for associated streams for dev %d", getSndDeviceId());
@@ -824,6 +824,9 @@ int HapticsDevProtection::HapticsDevStartCalibration(int32_t operation_mode)
                 }
                 hapticsDevCalState = HAPTICS_DEV_CALIBRATED;
                 outFile.close();
+                ThermalCalService::getInstance()->invalidate(
+                        operation_mode == FACTORY_TEST_MODE ?
+                        PAL_HAP_DEVP_FTM_PATH : PAL_HAP_DEVP_CAL_PATH);
             }
         } else if (calibrationCallbackStatus == HAPTICS_VI_CALIB_STATE_FAILED) {
             PAL_DBG(LOG_TAG, "haptics calibration unsuccessful!");
@@ -911,27 +914,11 @@ SkipCalib:
 /* LRA temperature unused currently */
 int HapticsDevProtection::getDevTemperature(int haptics_dev_pos)
 {
-    struct mixer_ctl *ctl;
-    std::string mixer_ctl_name;
     int status = 0;
 
     PAL_DBG(LOG_TAG, "Enter: HapticsDevice Get Temperature %d", haptics_dev_pos);
-    if (mixer_ctl_name.empty()) {
-        PAL_DBG(LOG_TAG, "Using default mixer control");
-        mixer_ctl_name = getDefaultHapticsDevTempCtrl(haptics_dev_pos);
-    }
-
-    PAL_DBG(LOG_TAG, "audio_mixer %pK", hwMixer);
-
-    ctl = mixer_get_ctl_by_name(hwMixer, mixer_ctl_name.c_str());
-    if (!ctl) {
-        PAL_ERR(LOG_TAG, "Invalid mixer control: %s\n", mixer_ctl_name.c_str());
-        status = -EINVAL;
-        return status;
-    }
-
-    status = mixer_ctl_get_value(ctl, 0);
-
+    ThermalCalService::getInstance()->readTemperatures(hwMixer,
+            {{getDefaultHapticsDevTempCtrl(haptics_dev_pos)}}, &status);
     PAL_DBG(LOG_TAG, "Exit: HapticsDevice Get Temperature %d", status);
 
     return status;
@@ -945,15 +932,14 @@ int HapticsDevProtection::getDevTemperature(int haptics_dev_pos)
   */
 void HapticsDevProtection::getHapticsDevTemperatureList()
 {
-    int i = 0;
-    int value;
+    std::vector<ThermalCalService::TempCtrlNames> channels;
+
     PAL_DBG(LOG_TAG, "Enter  HapticsDevice Get Temperature List");
+    for (int i = 0; i < numberOfChannels; i++)
+        channels.push_back({getDefaultHapticsDevTempCtrl(i)});
 
-    for(i = 0; i < numberOfChannels; i++) {
-         value = getDevTemperature(i);
-         PAL_DBG(LOG_TAG, "Temperature %d ", value);
-         devTempList[i] = value;
-    }
+    ThermalCalService::getInstance()->readTemperatures(hwMixer, channels,
+                                                       devTempList);
     PAL_DBG(LOG_TAG, "Exit  HapticsDevice Get Temperature List");
 }
 
@@ -1696,18 +1682,19 @@ int32_t HapticsDevProtection::getFTMParameter(void **param)
 {
     int ret = 0;
     int32_t payload_size = 0;
-    std::ifstream inFile;
+    size_t offset = 0;
     std::ostringstream resString;
     haptics_vi_cal_param FtmCalParam;
+    ThermalCalService::CalData cal =
+            ThermalCalService::getInstance()->getCalData(PAL_HAP_DEVP_FTM_PATH);
 
-    inFile.open(PAL_HAP_DEVP_FTM_PATH, std::ios::binary | std::ios::in);
-    if (!inFile.is_open()) {
+    memset(&FtmCalParam, 0, sizeof(FtmCalParam));
+    if (!cal) {
         PAL_ERR(LOG_TAG, "Unable to open file for read");
         ret = -EINVAL;
         goto exit;
     }
-    inFile.read(reinterpret_cast<char*>(&FtmCalParam), sizeof(haptics_vi_cal_param));
-    inFile.close();
+    ThermalCalService::readCal(cal, &offset, &FtmCalParam, sizeof(haptics_vi_cal_param));
 
     resString << "HapticsParamStatus: " <<  "; Re: "
               << ((FtmCalParam.Re_ohm_Cal_q24)/(1<<24)) << "; Fres: "
@@ -1858,6 +1845,8 @@ int32_t HapticsDevProtection::getAndsetPersistentParameter(bool flag)
     size_t payloadSize = 0;
     struct mixer_ctl *ctl;
     FILE *fp;
+    size_t offset = 0;
+    ThermalCalService::CalData cal;
     std::ostringstream cntrlName;
     std::ostringstream resString;
     std::string backendName;
@@ -1937,12 +1926,13 @@ int32_t HapticsDevProtection::getAndsetPersistentParameter(bool flag)
                                              1, fp);
                 }
                 fclose(fp);
+                ThermalCalService::getInstance()->invalidate(PAL_HP_VI_PER_PATH);
             }
         }
     }
     else {
-        fp = fopen(PAL_HP_VI_PER_PATH, "rb");
-        if (fp) {
+        cal = ThermalCalService::getInstance()->getCalData(PAL_HP_VI_PER_PATH);
+        if (cal) {
             VIpeValue = (param_id_haptics_ex_vi_persistent *)calloc(1,
                                sizeof(param_id_haptics_ex_vi_persistent));
             if (!VIpeValue) {
@@ -1951,26 +1941,25 @@ int32_t HapticsDevProtection::getAndsetPersistentParameter(bool flag)
             }
             PAL_DBG(LOG_TAG, "update Vi persistant value from file");
             for (int i = 0; i < numberOfChannels; i++) {
-                    fread(&VIpeValue->Re_ohm_q24[i], sizeof(VIpeValue->Re_ohm_q24[i]),
-                                             1, fp);
+                    ThermalCalService::readCal(cal, &offset, &VIpeValue->Re_ohm_q24[i],
+                                             sizeof(VIpeValue->Re_ohm_q24[i]));
                      PAL_ERR(LOG_TAG, "persistent values VIpeValue->Re_ohm_q24[i] =%d",VIpeValue->Re_ohm_q24[i]);
-                    fread(&VIpeValue->Le_mH_q24[i], sizeof(VIpeValue->Le_mH_q24[i]),
-                                             1, fp);
+                    ThermalCalService::readCal(cal, &offset, &VIpeValue->Le_mH_q24[i],
+                                             sizeof(VIpeValue->Le_mH_q24[i]));
                      PAL_ERR(LOG_TAG, "persistent values VIpeValue->Le_mH_q24[i] =%d",VIpeValue->Le_mH_q24[i]);
-                    fread(&VIpeValue->Bl_q24[i], sizeof(VIpeValue->Bl_q24[i]),
-                                             1, fp);
+                    ThermalCalService::readCal(cal, &offset, &VIpeValue->Bl_q24[i],
+                                             sizeof(VIpeValue->Bl_q24[i]));
                      PAL_ERR(LOG_TAG, "persistent values VIpeValue->Bl_q24[i] =%d",VIpeValue->Bl_q24[i]);
-                    fread(&VIpeValue->Rms_KgSec_q24[i], sizeof(VIpeValue->Rms_KgSec_q24[i]),
-                                             1, fp);
+                    ThermalCalService::readCal(cal, &offset, &VIpeValue->Rms_KgSec_q24[i],
+                                             sizeof(VIpeValue->Rms_KgSec_q24[i]));
                     PAL_ERR(LOG_TAG, "persistent values VIpeValue->Rms_KgSec_q24[i] =%d",VIpeValue->Rms_KgSec_q24[i]);
-                    fread(&VIpeValue->Kms_Nmm_q24[i], sizeof(VIpeValue->Kms_Nmm_q24[i]),
-                                             1, fp);
+                    ThermalCalService::readCal(cal, &offset, &VIpeValue->Kms_Nmm_q24[i],
+                                             sizeof(VIpeValue->Kms_Nmm_q24[i]));
                      PAL_ERR(LOG_TAG, "persistent values VIpeValue->Kms_Nmm_q24[i] =%d",VIpeValue->Kms_Nmm_q24[i]);
-                    fread(&VIpeValue->Fres_Hz_q20[i], sizeof(VIpeValue->Fres_Hz_q20[i]),
-                                             1, fp);
+                    ThermalCalService::readCal(cal, &offset, &VIpeValue->Fres_Hz_q20[i],
+                                             sizeof(VIpeValue->Fres_Hz_q20[i]));
                      PAL_ERR(LOG_TAG, "persistent values VIpeValue->Fres_Hz_q20[i] =%d",VIpeValue->Fres_Hz_q20[i]);
             }
-            fclose(fp);
         }
         else {
             PAL_DBG(LOG_TAG, "Use the default Persistent values");
@@ -2013,7 +2002,8 @@ void HapticsDevFeedback::updateVIcustomPayload()
     std::vector<Stream*> activeStreams;
     uint32_t miid = 0, ret = 0;
     struct param_id_haptics_th_vi_r0t0_set_param_t r0t0Value;
-    FILE *fp = NULL;
+    size_t offset = 0;
+    ThermalCalService::CalData cal;
     param_id_haptics_th_vi_r0t0_set_param_t *hpR0T0confg;
     param_id_haptics_vi_op_mode_param_t modeConfg;
     param_id_haptics_vi_channel_map_cfg_t HapticsviChannelMapConfg;
@@ -2077,14 +2067,14 @@ void HapticsDevFeedback::updateVIcustomPayload()
         return;
     }
     hpR0T0confg->num_channels = numDevice;
-    fp = fopen(PAL_HAP_DEVP_CAL_PATH, "rb");
-    if (fp) {
+    cal = ThermalCalService::getInstance()->getCalData(PAL_HAP_DEVP_CAL_PATH);
+    if (cal) {
         PAL_DBG(LOG_TAG, " HapticsDevice calibrated. Send calibrated value");
         for (int i = 0; i < numDevice; i++) {
-            fread(&r0t0Value.r0_cali_q24[i],
-                    sizeof(r0t0Value.r0_cali_q24[i]), 1, fp);
-            fread(&r0t0Value.t0_cali_q6[i],
-                    sizeof(r0t0Value.t0_cali_q6[i]), 1, fp);
+            ThermalCalService::readCal(cal, &offset, &r0t0Value.r0_cali_q24[i],
+                    sizeof(r0t0Value.r0_cali_q24[i]));
+            ThermalCalService::readCal(cal, &offset, &r0t0Value.t0_cali_q6[i],
+                    sizeof(r0t0Value.t0_cali_q6[i]));
         }
     }
     else {
@@ -117,6 +117,9 @@
 
 #define MAX_RETRY 3
 
+/* keep the suspended VI graph well below the calibration idle window */
+#define MAX_VI_IDLE_HOLD_MS (30 * 1000)
+
 std::thread SpeakerProtection::mCalThread;
 std::thread SpeakerProtection::viTxSetupThread;
 std::condition_variable SpeakerProtection::cv;
@@ -141,6 +144,12 @@ struct pal_device_info SpeakerProtection::cps_device;
 int SpeakerProtection::calibrationCallbackStatus;
 int SpeakerProtection::numberOfRequest;
 bool SpeakerProtection::mDspCallbackRcvd;
+bool SpeakerProtection::viTxSuspended = false;
+SpeakerProtection *SpeakerProtection::viTxSuspendedOwner = NULL;
+std::string SpeakerProtection::viTxSuspendedDev;
+int SpeakerProtection::viTxSuspendedMode;
+uint32_t SpeakerProtection::viTxSuspendGen = 0;
+PalReactor::TimerId SpeakerProtection::viTxIdleTimer = 0;
 std::shared_ptr<Device> SpeakerFeedback::obj = nullptr;
 int SpeakerFeedback::numSpeaker;
 
@@ -362,46 +371,37 @@ int SpeakerProtection::getCpsDevNumber(std::string mixer_name)
     return status;
 }
 
-int SpeakerProtection::getSpeakerTemperature(int spkr_pos)
+ThermalCalService::TempCtrlNames SpeakerProtection::getSpkrTempCtrlNames(int spkr_pos)
 {
-    struct mixer_ctl *ctl;
+    ThermalCalService::TempCtrlNames names;
     std::string mixer_ctl_name;
-    int status = 0;
+
     /**
      * It is assumed that for Mono speakers only right speaker will be there.
      * Thus we will get the Temperature just for right speaker.
      * TODO: Get the channel from RM.xml
      */
-    PAL_DBG(LOG_TAG, "Enter Speaker Get Temperature %d", spkr_pos);
     mixer_ctl_name = rm->getSpkrTempCtrl(spkr_pos);
     if (mixer_ctl_name.empty()) {
         PAL_DBG(LOG_TAG, "Using default mixer control");
         mixer_ctl_name = getDefaultSpkrTempCtrl(spkr_pos);
     }
+    names.push_back(mixer_ctl_name);
 
-    PAL_DBG(LOG_TAG, "audio_mixer %pK", hwMixer);
+    /* It is possible for only the Left Spkr to exist */
+    if (numberOfChannels == 1 && spkr_pos == SPKR_RIGHT)
+        names.push_back(getDefaultSpkrTempCtrl(SPKR_LEFT));
 
-    ctl = mixer_get_ctl_by_name(hwMixer, mixer_ctl_name.c_str());
-    if (!ctl) {
-        if (numberOfChannels == 1 && spkr_pos == SPKR_RIGHT) {
-            /* It is possible for only the Left Spkr to exist */
-            mixer_ctl_name = getDefaultSpkrTempCtrl(SPKR_LEFT);
-            ctl = mixer_get_ctl_by_name(hwMixer, mixer_ctl_name.c_str());
-            if (!ctl) {
-                PAL_ERR(LOG_TAG, "Invalid mixer control: %s\n", mixer_ctl_name.c_str());
-            } else {
-                goto get_temp;
-            }
-        }
-        PAL_ERR(LOG_TAG, "Invalid mixer control: %s\n", mixer_ctl_name.c_str());
-        status = -EINVAL;
-        return status;
-    }
+    return names;
+}
 
-get_temp:
-    PAL_DBG(LOG_TAG, "Used %s for Temperature value", mixer_ctl_name.c_str());
-    status = mixer_ctl_get_value(ctl, 0);
+int SpeakerProtection::getSpeakerTemperature(int spkr_pos)
+{
+    int status = 0;
 
+    PAL_DBG(LOG_TAG, "Enter Speaker Get Temperature %d", spkr_pos);
+    ThermalCalService::getInstance()->readTemperatures(hwMixer,
+            {getSpkrTempCtrlNames(spkr_pos)}, &status);
     PAL_DBG(LOG_TAG, "Exiting Speaker Get Temperature %d", status);
 
     return status;
@@ -502,6 +502,9 @@ int SpeakerProtection::spkrStartCalibration()
 
     std::unique_lock<std::mutex> calLock(calibrationMutex);
 
+    // calibration sets up its own VI graph on the same backend
+    closeSuspendedViTx_l();
+
     memset(&device, 0, sizeof(device));
     memset(&deviceRx, 0, sizeof(deviceRx));
     memset(&sAttr, 0, sizeof(sAttr));
@@ -1020,6 +1023,7 @@ int SpeakerProtection::spkrStartCalibration()
                 spkrCalState = SPKR_CALIBRATED;
                 free(callback_data);
                 fclose(fp);
+                ThermalCalService::getInstance()->invalidate(PAL_SP_TEMP_PATH);
             }
         }
         else if (calibrationCallbackStatus == CALIBRATION_STATUS_FAILURE) {
@@ -1110,15 +1114,14 @@ exit:
   */
 void SpeakerProtection::getSpeakerTemperatureList()
 {
-    int i = 0;
-    int value;
+    std::vector<ThermalCalService::TempCtrlNames> channels;
+
     PAL_DBG(LOG_TAG, "Enter Speaker Get Temperature List");
+    for (int i = 0; i < numberOfChannels; i++)
+        channels.push_back(getSpkrTempCtrlNames(i));
 
-    for(i = 0; i < numberOfChannels; i++) {
-         value = getSpeakerTemperature(i);
-         PAL_DBG(LOG_TAG, "Temperature %d ", value);
-         spkerTempList[i] = value;
-    }
+    ThermalCalService::getInstance()->readTemperatures(hwMixer, channels,
+                                                       spkerTempList);
     PAL_DBG(LOG_TAG, "Exit Speaker Get Temperature List");
 }
 
@@ -1224,7 +1227,6 @@ SpeakerProtection::SpeakerProtection(struct pal_device *device,
 {
     int status = 0;
     struct pal_device_info devinfo = {};
-    FILE *fp = NULL;
 
     spkerTempList = NULL;
 
@@ -1286,8 +1288,7 @@ SpeakerProtection::SpeakerProtection(struct pal_device *device,
         goto exit;
     }
 
-    fp = fopen(PAL_SP_TEMP_PATH, "rb");
-    if (fp) {
+    if (ThermalCalService::getInstance()->getCalData(PAL_SP_TEMP_PATH)) {
         PAL_DBG(LOG_TAG, "Cal File exists. Reading from it");
         spkrCalState = SPKR_CALIBRATED;
     }
@@ -1303,6 +1304,12 @@ exit:
 
 SpeakerProtection::~SpeakerProtection()
 {
+    {
+        std::lock_guard<std::mutex> lck(calibrationMutex);
+        if (viTxSuspendedOwner == this)
+            closeSuspendedViTx_l();
+    }
+
     if (spkerTempList)
         delete[] spkerTempList;
 
@@ -1442,6 +1449,40 @@ exit:
     }
 }
 
+/*
+ * Fills r0t0Array from the calibration file, or with safe values if the
+ * speaker is not calibrated. Returns false in the latter case.
+ * ThermalCalService holds the only in-memory copy of the cal file, it is
+ * read again once calibration rewrites the file, so a VI graph set up or
+ * resumed after calibration gets the new values.
+ */
+bool SpeakerProtection::loadR0T0(vi_r0t0_cfg_t r0t0Array[], int channels)
+{
+    size_t offset = 0;
+    bool calibrated = true;
+    ThermalCalService::CalData cal =
+            ThermalCalService::getInstance()->getCalData(PAL_SP_TEMP_PATH);
+
+    for (int i = 0; i < channels; i++) {
+        if (!ThermalCalService::readCal(cal, &offset, &r0t0Array[i].r0_cali_q24,
+                    sizeof(r0t0Array[i].r0_cali_q24)) ||
+            !ThermalCalService::readCal(cal, &offset, &r0t0Array[i].t0_cali_q6,
+                    sizeof(r0t0Array[i].t0_cali_q6))) {
+            calibrated = false;
+            break;
+        }
+    }
+
+    if (!calibrated) {
+        for (int i = 0; i < channels; i++) {
+            r0t0Array[i].r0_cali_q24 = MIN_RESISTANCE_SPKR_Q24;
+            r0t0Array[i].t0_cali_q6 = SAFE_SPKR_TEMP_Q6;
+        }
+    }
+
+    return calibrated;
+}
+
 int SpeakerProtection::viTxSetupThreadLoop()
 {
     int ret = 0, dir = TX_HOSTLESS, flags, viParamId =0;
@@ -1462,7 +1503,6 @@ int SpeakerProtection::viTxSetupThreadLoop()
     struct vi_r0t0_cfg_t r0t0Array[numberOfChannels];
     struct agmMetaData deviceMetaData(nullptr, 0);
     struct mixer_ctl *beMetaDataMixerCtrl = nullptr;
-    FILE *fp;
     std::string backEndName;
     std::vector <std::pair<int, int>> keyVector;
     std::vector <std::pair<int, int>> calVector;
@@ -1797,23 +1837,8 @@ int SpeakerProtection::viTxSetupThreadLoop()
     }
 
     // Setting the R0T0 values
-    PAL_DBG(LOG_TAG, "Read R0T0 from file");
-    fp = fopen(PAL_SP_TEMP_PATH, "rb");
-    if (fp) {
-        for (int i = 0; i < vi_device.channels; i++) {
-            fread(&r0t0Array[i].r0_cali_q24,
-                    sizeof(r0t0Array[i].r0_cali_q24), 1, fp);
-            fread(&r0t0Array[i].t0_cali_q6,
-                    sizeof(r0t0Array[i].t0_cali_q6), 1, fp);
-        }
-        fclose(fp);
-    } else {
+    if (!loadR0T0(r0t0Array, vi_device.channels))
         PAL_DBG(LOG_TAG, "Speaker not calibrated. Send safe values");
-        for (int i = 0; i < vi_device.channels; i++) {
-            r0t0Array[i].r0_cali_q24 = MIN_RESISTANCE_SPKR_Q24;
-            r0t0Array[i].t0_cali_q6 = SAFE_SPKR_TEMP_Q6;
-        }
-    }
     spR0T0confg = (param_id_sp_th_vi_r0t0_cfg_t*)calloc(1,
                         sizeof(param_id_sp_th_vi_r0t0_cfg_t) +
                         sizeof(vi_r0t0_cfg_t) * vi_device.channels);
@@ -1949,6 +1974,143 @@ exit:
     return ret;
 }
 
+void SpeakerProtection::closeViTxPath_l(char *sndDevName)
+{
+    int ret = 0, dir = TX_HOSTLESS;
+    std::string backEndName;
+    struct audio_route *audioRoute = NULL;
+    struct pal_stream_attributes sAttr;
+    std::shared_ptr<ResourceManager> rm = ResourceManager::getInstance();
+
+    if (!txPcm || !rm)
+        return;
+
+    ret = rm->getAudioRoute(&audioRoute);
+    if (0 != ret) {
+        PAL_ERR(LOG_TAG, "Failed to get the audio_route address status %d", ret);
+        return;
+    }
+
+    rm->getBackendName(PAL_DEVICE_IN_VI_FEEDBACK, backEndName);
+    if (!strlen(backEndName.c_str())) {
+        PAL_ERR(LOG_TAG, "Failed to obtain tx backend name for %d",
+                PAL_DEVICE_IN_VI_FEEDBACK);
+        return;
+    }
+    pcm_stop(txPcm);
+    if (pcmDevIdTx.size() != 0) {
+        disconnectFeandBe(pcmDevIdTx, backEndName);
+        memset(&sAttr, 0, sizeof(sAttr));
+        sAttr.type = PAL_STREAM_LOW_LATENCY;
+        sAttr.direction = PAL_AUDIO_INPUT_OUTPUT;
+        rm->freeFrontEndIds(pcmDevIdTx, sAttr, dir);
+        pcmDevIdTx.clear();
+    }
+    pcm_close(txPcm);
+    disableDevice(audioRoute, sndDevName);
+    txPcm = NULL;
+}
+
+/*
+ * Stop the VI feedback but keep the graph prepared and the FE/BE connected,
+ * the next speaker start only has to restart the pcm. The graph is closed
+ * once the speaker stayed idle for vi_idle_hold_ms.
+ */
+void SpeakerProtection::suspendViTx_l(char *sndDevName)
+{
+    uint32_t holdMs = std::min(ResourceManager::spViIdleHoldMs, MAX_VI_IDLE_HOLD_MS);
+    uint32_t gen = 0;
+    std::shared_ptr<ResourceManager> rm = ResourceManager::getInstance();
+
+    if (pcm_stop(txPcm) < 0) {
+        PAL_ERR(LOG_TAG, "pcm stop failed for TX path, closing it");
+        closeViTxPath_l(sndDevName);
+        return;
+    }
+
+    viTxSuspended = true;
+    viTxSuspendedOwner = this;
+    viTxSuspendedDev = sndDevName;
+    viTxSuspendedMode = rm->mSpkrProtModeValue.operationMode;
+    gen = ++viTxSuspendGen;
+    viTxIdleTimer = PalReactor::getInstance()->postDelayed(holdMs,
+                        [gen]() { onViTxIdleTimeout(gen); }, true);
+    if (!viTxIdleTimer) {
+        PAL_ERR(LOG_TAG, "failed to arm VI idle timer, closing VI path");
+        closeSuspendedViTx_l();
+        return;
+    }
+    PAL_DBG(LOG_TAG, "VI path suspended, close in %u ms", holdMs);
+}
+
+/*
+ * Restart a suspended VI graph if it was set up for the same device and
+ * mode, otherwise close it so that the caller builds a new one.
+ */
+bool SpeakerProtection::resumeSuspendedViTx_l(char *sndDevName)
+{
+    std::shared_ptr<ResourceManager> rm = ResourceManager::getInstance();
+
+    if (!viTxSuspended)
+        return false;
+
+    if (viTxSuspendedOwner != this || viTxSuspendedDev != sndDevName ||
+        viTxSuspendedMode != rm->mSpkrProtModeValue.operationMode) {
+        PAL_DBG(LOG_TAG, "suspended VI path %s does not match %s",
+                viTxSuspendedDev.c_str(), sndDevName);
+        closeSuspendedViTx_l();
+        return false;
+    }
+
+    PalReactor::getInstance()->cancel(viTxIdleTimer);
+    viTxIdleTimer = 0;
+    viTxSuspendGen++;
+    viTxSuspended = false;
+    viTxSuspendedOwner = NULL;
+
+    if (pcm_start(txPcm) < 0) {
+        PAL_ERR(LOG_TAG, "pcm start failed for suspended TX path");
+        closeViTxPath_l(sndDevName);
+        return false;
+    }
+    PAL_DBG(LOG_TAG, "VI path resumed");
+
+    return true;
+}
+
+void SpeakerProtection::closeSuspendedViTx_l()
+{
+    char sndDevName[DEVICE_NAME_MAX_SIZE] = {0};
+    SpeakerProtection *owner = viTxSuspendedOwner;
+
+    if (!viTxSuspended)
+        return;
+
+    if (viTxIdleTimer)
+        PalReactor::getInstance()->cancel(viTxIdleTimer);
+    viTxIdleTimer = 0;
+    viTxSuspendGen++;
+    viTxSuspended = false;
+    viTxSuspendedOwner = NULL;
+
+    strlcpy(sndDevName, viTxSuspendedDev.c_str(), DEVICE_NAME_MAX_SIZE);
+    PAL_DBG(LOG_TAG, "Closing suspended VI path %s", sndDevName);
+    if (owner)
+        owner->closeViTxPath_l(sndDevName);
+}
+
+void SpeakerProtection::onViTxIdleTimeout(uint32_t gen)
+{
+    std::unique_lock<std::mutex> lock(calibrationMutex);
+
+    // a resume or close after the timer fired already took care of it
+    if (!viTxSuspended || gen != viTxSuspendGen)
+        return;
+
+    viTxIdleTimer = 0;
+    closeSuspendedViTx_l();
+}
+
 /*
  * Function to trigger Processing mode.
  * The parameter that it accepts are below:
@@ -1964,7 +2126,6 @@ int32_t SpeakerProtection::spkrProtProcessingMode(bool flag)
     uint8_t* payload = NULL;
     uint32_t devicePropId[] = {0x08000010, 1, 0x2};
     uint32_t miid = 0;
-    bool isTxFeandBeConnected = true;
     bool isCPSFeandBeConnected = true;
     size_t payloadSize = 0;
     struct pal_device device, deviceCPS;
@@ -1976,7 +2137,7 @@ int32_t SpeakerProtection::spkrProtProcessingMode(bool flag)
     struct audio_route *audioRoute = NULL;
     struct agmMetaData deviceMetaData(nullptr, 0);
     struct mixer_ctl *beMetaDataMixerCtrl = nullptr;
-    std::string backEndName, backEndNameRx, backEndNameCPS;
+    std::string backEndNameRx, backEndNameCPS;
     std::vector <std::pair<int, int>> keyVector;
     std::vector <std::pair<int, int>> calVector;
     std::shared_ptr<ResourceManager> rm;
@@ -2049,7 +2210,9 @@ int32_t SpeakerProtection::spkrProtProcessingMode(bool flag)
         /* Instantiate the viTxSetupThread
          * Move the complete vi tx setup path to that
          * and return back */
-        if(!viTxSetupThrdCreated) {
+        if (resumeSuspendedViTx_l(mSndDeviceName_vi)) {
+            PAL_DBG(LOG_TAG, "reusing suspended VI path");
+        } else if(!viTxSetupThrdCreated) {
             viTxSetupThread = std::thread(&SpeakerProtection::viTxSetupThreadLoop,
                     this);
             PAL_DBG(LOG_TAG, " Created vi tx thread :%s ", __func__);
@@ -2363,33 +2526,10 @@ cps_dev_setup:
         }
         PAL_DBG(LOG_TAG, "vi tx setup thread joined");
         if (txPcm) {
-            rm = ResourceManager::getInstance();
-            device.id = PAL_DEVICE_IN_VI_FEEDBACK;
-
-            ret = rm->getAudioRoute(&audioRoute);
-            if (0 != ret) {
-                PAL_ERR(LOG_TAG, "Failed to get the audio_route address status %d", ret);
-                goto exit;
-            }
-
-            rm->getBackendName(device.id, backEndName);
-            if (!strlen(backEndName.c_str())) {
-                PAL_ERR(LOG_TAG, "Failed to obtain tx backend name for %d", device.id);
-                goto exit;
-            }
-            pcm_stop(txPcm);
-            if (pcmDevIdTx.size() != 0) {
-                if (isTxFeandBeConnected) {
-                    disconnectFeandBe(pcmDevIdTx, backEndName);
-                }
-                sAttr.type = PAL_STREAM_LOW_LATENCY;
-                sAttr.direction = PAL_AUDIO_INPUT_OUTPUT;
-                rm->freeFrontEndIds(pcmDevIdTx, sAttr, dir);
-                pcmDevIdTx.clear();
-            }
-            pcm_close(txPcm);
-            disableDevice(audioRoute, mSndDeviceName_vi);
-            txPcm = NULL;
+            if (ResourceManager::spViIdleHoldMs > 0)
+                suspendViTx_l(mSndDeviceName_vi);
+            else
+                closeViTxPath_l(mSndDeviceName_vi);
         }
         PAL_DBG(LOG_TAG, "Closing CPS path");
         if (cpsPcm) {
@@ -2775,19 +2915,20 @@ int32_t SpeakerProtection::getCalibrationData(void **param)
     memset(dr0, 0, sizeof(double) * numberOfChannels);
     memset(dt0, 0, sizeof(double) * numberOfChannels);
 
-    FILE *fp = fopen(PAL_SP_TEMP_PATH, "rb");
-    if (fp) {
+    ThermalCalService::CalData cal =
+            ThermalCalService::getInstance()->getCalData(PAL_SP_TEMP_PATH);
+    size_t offset = 0;
+    if (cal) {
         for (i = 0; i < numberOfChannels; i++) {
-            fread(&r0t0Array[i].r0_cali_q24,
-                    sizeof(r0t0Array[i].r0_cali_q24), 1, fp);
-            fread(&r0t0Array[i].t0_cali_q6,
-                    sizeof(r0t0Array[i].t0_cali_q6), 1, fp);
+            ThermalCalService::readCal(cal, &offset, &r0t0Array[i].r0_cali_q24,
+                    sizeof(r0t0Array[i].r0_cali_q24));
+            ThermalCalService::readCal(cal, &offset, &r0t0Array[i].t0_cali_q6,
+                    sizeof(r0t0Array[i].t0_cali_q6));
             // Convert to readable format
             dr0[i] = ((double)r0t0Array[i].r0_cali_q24)/(1 << 24);
             dt0[i] = ((double)r0t0Array[i].t0_cali_q6)/(1 << 6);
         }
         PAL_DBG(LOG_TAG, "R0= %lf, %lf, T0= %lf, %lf", dr0[0], dr0[1], dt0[0], dt0[1]);
-        fclose(fp);
     }
     else {
         status = -EINVAL;
@@ -2841,7 +2982,6 @@ void SpeakerFeedback::updateVIcustomPayload()
     std::vector<Stream*> activeStreams;
     uint32_t miid = 0, ret = 0;
     struct vi_r0t0_cfg_t r0t0Array[numSpeaker];
-    FILE *fp = NULL;
     param_id_sp_th_vi_r0t0_cfg_t *spR0T0confg;
     param_id_sp_vi_op_mode_cfg_t modeConfg;
     param_id_sp_vi_channel_map_cfg_t viChannelMapConfg;
@@ -2900,22 +3040,10 @@ void SpeakerFeedback::updateVIcustomPayload()
         }
     }
 
-    fp = fopen(PAL_SP_TEMP_PATH, "rb");
-    if (fp) {
+    if (SpeakerProtection::loadR0T0(r0t0Array, numSpeaker)) {
         PAL_DBG(LOG_TAG, "Speaker calibrated. Send calibrated value");
-        for (int i = 0; i < numSpeaker; i++) {
-            fread(&r0t0Array[i].r0_cali_q24,
-                    sizeof(r0t0Array[i].r0_cali_q24), 1, fp);
-            fread(&r0t0Array[i].t0_cali_q6,
-                    sizeof(r0t0Array[i].t0_cali_q6), 1, fp);
-        }
-    }
-    else {
+    } else {
         PAL_DBG(LOG_TAG, "Speaker not calibrated. Send safe value");
-        for (int i = 0; i < numSpeaker; i++) {
-            r0t0Array[i].r0_cali_q24 = MIN_RESISTANCE_SPKR_Q24;
-            r0t0Array[i].t0_cali_q6 = SAFE_SPKR_TEMP_Q6;
-        }
     }
     spR0T0confg = (param_id_sp_th_vi_r0t0_cfg_t *)calloc(1,
                         sizeof(param_id_sp_th_vi_r0t0_cfg_t) +
@@ -2969,6 +3097,10 @@ SpeakerFeedback::~SpeakerFeedback()
 int32_t SpeakerFeedback::start()
 {
     ResourceManager::isVIRecordStarted = true;
+    {
+        std::lock_guard<std::mutex> lck(SpeakerProtection::calibrationMutex);
+        SpeakerProtection::closeSuspendedViTx_l();
+    }
     // Do the customPayload configuration for VI path and call the Device::start
     PAL_DBG(LOG_TAG," Feedback start\n");
     if (rm->isSpeakerProtectionEnabled)
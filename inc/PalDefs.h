@@ -743,6 +743,7 @@ typedef enum {
     PAL_STREAM_CBK_EVENT_PARTIAL_DRAIN_READY, /* partial drain completed */
     PAL_STREAM_CBK_EVENT_READ_DONE, /* non blocking read completed */
     PAL_STREAM_CBK_EVENT_ERROR, /* stream hit some error, let AF take action */
+    PAL_STREAM_CBK_EVENT_BUFFER_CONFIG, /* adaptive period size changed */
     PAL_STREAM_CBK_MAX = 0xFFFF,
 } pal_stream_callback_event_t;
 
@@ -1080,6 +1081,8 @@ typedef enum {
     PAL_PARAM_ID_ASR_SET_PARAM = 82,
     PAL_PARAM_ID_HAPTICS_MODE = 83,
     PAL_PARAM_ID_ULTRASOUND_SET_GAIN = 84,
+    PAL_PARAM_ID_GAPLESS_NEXT_MDATA = 85,
+    PAL_PARAM_ID_NEXT_CODEC_CONFIGURATION = 86,
 } pal_param_id_type_t;
 
 /** HDMI/DP */
@@ -1676,6 +1679,12 @@ struct pal_asr_event {
     struct pal_asr_engine_event event[];
 };
 
+/* Payload For ID: PAL_PARAM_ID_GAPLESS_MDATA, PAL_PARAM_ID_GAPLESS_NEXT_MDATA
+ * Description   : Gapless metadata. The NEXT variant, like
+ *                 PAL_PARAM_ID_NEXT_CODEC_CONFIGURATION, can be set while the
+ *                 current track still plays and is applied to the next track
+ *                 as soon as the partial drain marks the track boundary.
+ */
 struct pal_compr_gapless_mdata {
        uint32_t encoderDelay;
        uint32_t encoderPadding;
@@ -1697,6 +1706,16 @@ struct pal_event_read_write_done_payload {
     struct pal_buffer buff; /**< buffer that was passed to pal_stream_read/pal_stream_write */
 };
 
+/**
+ * Event payload passed to client with PAL_STREAM_CBK_EVENT_BUFFER_CONFIG,
+ * raised when a stream with adaptive buffering opens with a new period
+ */
+struct pal_event_buffer_config_payload {
+    uint32_t period_frames; /**< frames per DSP period */
+    uint32_t period_count;  /**< periods in the buffer */
+    uint32_t latency_us;    /**< period_frames * period_count in microseconds */
+};
+
 /** @brief Callback function prototype to be given for
  *         pal_open_stream.
  *
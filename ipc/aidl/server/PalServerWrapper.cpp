@@ -13,8 +13,11 @@
 #include <pal/SharedMemoryWrapper.h>
 #include <pal/Utils.h>
 #include "MetadataParser.h"
+#include "PalThreadPolicy.h"
+#include <sys/eventfd.h>
 
 #define MAX_CACHE_SIZE 64
+#define MAX_SHARED_BUFFER_SLOTS 32
 
 using ndk::ScopedAStatus;
 
@@ -48,16 +51,18 @@ int getInputBufferIndex(int fd, int32_t offset, int64_t &bufIndex) {
     ALOGV("%s: fd %d, offset %u", __func__, fd, offset);
     std::map<int, std::map<int32_t, int64_t>>::iterator itFd = gInputsPendingAck.find(fd);
     if (itFd != gInputsPendingAck.end()) {
-        std::map<int32_t, int64_t> offsetToFrameIdxMap = itFd->second;
+        std::map<int32_t, int64_t> &offsetToFrameIdxMap = itFd->second;
         auto itOffsetFrameIdxPair = offsetToFrameIdxMap.find(offset);
         if (itOffsetFrameIdxPair != offsetToFrameIdxMap.end()) {
             bufIndex = itOffsetFrameIdxPair->second;
             ALOGV("%s ipFrameId=%lu", __func__, (unsigned long)bufIndex);
+            // the dup fd stays registered, other offsets may still be pending
+            offsetToFrameIdxMap.erase(itOffsetFrameIdxPair);
         } else {
             status = -EINVAL;
             ALOGE("%s: Entry doesn't exist for FD 0x%x and offset 0x%x", __func__, fd, offset);
         }
-        gInputsPendingAck.erase(itFd);
+        if (offsetToFrameIdxMap.empty()) gInputsPendingAck.erase(itFd);
     }
     return status;
 }
@@ -75,15 +80,13 @@ void StreamInfo::forceCloseStream() {
     }
 }
 
-void StreamInfo::addSharedMemoryFdPairs(int inputFd, int dupFd) {
-    std::lock_guard<std::mutex> guard(mLock);
+void StreamInfo::addSharedMemoryFdPairs_l(int inputFd, int dupFd) {
     ALOGV("%s handle %llx Fds[input %d - dup %d] size %d", __func__, mHandle, inputFd, dupFd,
           mInOutFdPairs.size());
     mInOutFdPairs.push_back(std::make_pair(inputFd, dupFd));
 }
 
-int StreamInfo::removeSharedMemoryFdPairs(int dupFd) {
-    std::lock_guard<std::mutex> guard(mLock);
+int StreamInfo::removeSharedMemoryFdPairs_l(int dupFd) {
     auto itr = mInOutFdPairs.begin();
     auto inputFd = -1;
     for (; itr != mInOutFdPairs.end(); itr++) {
@@ -98,14 +101,86 @@ int StreamInfo::removeSharedMemoryFdPairs(int dupFd) {
     return inputFd;
 }
 
+int StreamInfo::importSharedBuffer(int clientFd, int binderFd) {
+    struct stat st;
+    int dupFd = -1;
+
+    if (binderFd < 0) return -1;
+
+    std::lock_guard<std::mutex> guard(mLock);
+    if (fstat(binderFd, &st) == 0) {
+        auto itr = mSlotByClientFd.find(clientFd);
+        if (itr != mSlotByClientFd.end()) {
+            auto &slot = mBufferSlots[itr->second];
+            if (slot.dev == st.st_dev && slot.ino == st.st_ino) {
+                slot.inFlight++;
+                return slot.dupFd;
+            }
+            // client reused the fd number for another buffer, re-import if idle
+            if (slot.inFlight == 0) {
+                dupFd = dup(binderFd);
+                if (dupFd < 0) return -1;
+                ALOGV("%s handle %llx slot %zu fd[input %d] dup %d -> %d", __func__, mHandle,
+                      itr->second, clientFd, slot.dupFd, dupFd);
+                mSlotByDupFd.erase(slot.dupFd);
+                close(slot.dupFd);
+                slot.dupFd = dupFd;
+                slot.dev = st.st_dev;
+                slot.ino = st.st_ino;
+                slot.inFlight = 1;
+                mSlotByDupFd[dupFd] = itr->second;
+                return dupFd;
+            }
+        } else if (mBufferSlots.size() < MAX_SHARED_BUFFER_SLOTS) {
+            dupFd = dup(binderFd);
+            if (dupFd < 0) return -1;
+            mBufferSlots.push_back({clientFd, dupFd, st.st_dev, st.st_ino, 1});
+            mSlotByClientFd[clientFd] = mBufferSlots.size() - 1;
+            mSlotByDupFd[dupFd] = mBufferSlots.size() - 1;
+            ALOGI("%s handle %llx registered slot %zu fd[input %d - dup %d]", __func__, mHandle,
+                  mBufferSlots.size() - 1, clientFd, dupFd);
+            return dupFd;
+        }
+    }
+
+    // no slot available, fall back to a dup owned by this buffer only
+    dupFd = dup(binderFd);
+    if (dupFd >= 0) addSharedMemoryFdPairs_l(clientFd, dupFd);
+    return dupFd;
+}
+
+void StreamInfo::releaseSharedBuffer(int dupFd) {
+    std::lock_guard<std::mutex> guard(mLock);
+    auto itr = mSlotByDupFd.find(dupFd);
+    if (itr != mSlotByDupFd.end()) {
+        auto &slot = mBufferSlots[itr->second];
+        if (slot.inFlight > 0) slot.inFlight--;
+        return;
+    }
+
+    if (removeSharedMemoryFdPairs_l(dupFd) != -1) {
+        ALOGV("closing dup fd %d ", dupFd);
+        close(dupFd);
+    } else {
+        ALOGE("Error finding fd %d", dupFd);
+    }
+}
+
 void StreamInfo::closeSharedMemoryFdPairs() {
     std::lock_guard<std::mutex> guard(mLock);
-    ALOGI("Before %s handle %llx size %d", __func__, mHandle, mInOutFdPairs.size());
+    ALOGI("Before %s handle %llx size %d slots %zu", __func__, mHandle, mInOutFdPairs.size(),
+          mBufferSlots.size());
     auto itr = mInOutFdPairs.begin();
     for (; itr != mInOutFdPairs.end(); itr++) {
         close(itr->second);
     }
     mInOutFdPairs.clear();
+    for (auto &slot : mBufferSlots) {
+        close(slot.dupFd);
+    }
+    mBufferSlots.clear();
+    mSlotByClientFd.clear();
+    mSlotByDupFd.clear();
     ALOGI("After %s handle %llx size %d", __func__, mHandle, mInOutFdPairs.size());
 }
 
@@ -114,33 +189,22 @@ void ClientInfo::setPalServerWrapper(PalServerWrapper *wrapper) {
     sPalServerWrapper = wrapper;
 }
 
-void ClientInfo::addSharedMemoryFdPairs(int64_t handle, int inputFd, int dupFd) {
+int ClientInfo::importSharedBuffer(int64_t handle, int clientFd, int binderFd) {
     std::lock_guard<std::mutex> guard(mStreamLock);
-    ALOGV("%s handle %llx, inputFd %d dupFd %d streamSize %d", __func__, handle, inputFd, dupFd,
-          mStreamInfoMap.size());
-    for (auto &streamInfo : mStreamInfoMap) {
-        auto &streamInfoObj = streamInfo.second;
-        if (streamInfo.first == handle) {
-            streamInfoObj->addSharedMemoryFdPairs(inputFd, dupFd);
-            break;
-        }
+    auto itr = mStreamInfoMap.find(handle);
+
+    if (itr == mStreamInfoMap.end()) {
+        ALOGE("%s handle %llx not found", __func__, handle);
+        return -1;
     }
+    return itr->second->importSharedBuffer(clientFd, binderFd);
 }
 
-int ClientInfo::removeSharedMemoryFdPairs(int64_t handle, int dupFd) {
+std::shared_ptr<StreamInfo> ClientInfo::getStreamInfo(int64_t handle) {
     std::lock_guard<std::mutex> guard(mStreamLock);
+    auto itr = mStreamInfoMap.find(handle);
 
-    auto inputFd = -1;
-    for (auto &streamInfo : mStreamInfoMap) {
-        auto &streamInfoObj = streamInfo.second;
-        if (streamInfo.first == handle) {
-            inputFd = streamInfoObj->removeSharedMemoryFdPairs(dupFd);
-            break;
-        }
-    }
-    ALOGV("%s handle %llx, inputFd %d dupFd %d streamSize %d", __func__, handle, inputFd, dupFd,
-          mStreamInfoMap.size());
-    return inputFd;
+    return itr != mStreamInfoMap.end() ? itr->second : nullptr;
 }
 
 void ClientInfo::closeSharedMemoryFdPairs(int64_t handle) {
@@ -222,6 +286,12 @@ void ClientInfo::clearStreams() {
     mStreamInfoMap.clear();
 }
 
+std::shared_ptr<CallbackDispatcher> ClientInfo::getDispatcher() {
+    std::lock_guard<std::mutex> guard(mCallbackLock);
+    if (!mDispatcher) mDispatcher = std::make_shared<CallbackDispatcher>(mPid);
+    return mDispatcher;
+}
+
 void ClientInfo::clearCallbacks() {
     std::lock_guard<std::mutex> guard(mCallbackLock);
     ALOGV("client going out of scope clear callback of size %d", mCallbackInfo.size());
@@ -238,6 +308,7 @@ void ClientInfo::cleanup() {
             stream.second->closeSharedMemoryFdPairs();
         }
     }
+    if (mDispatcher) mDispatcher->stop();
     clearCallbacks();
     clearStreams();
 }
@@ -290,28 +361,20 @@ int32_t ClientInfo::onCallback(pal_stream_handle_t *handle, uint32_t eventId, ui
     CallbackInfo *callbackInfo = (CallbackInfo *)cookie;
     IPALCallback *callbackBinder = callbackInfo->mCallback.get();
 
-    if (!AIBinder_isAlive(callbackBinder->asBinder().get())) {
-        ALOGW("callback binder has died");
-        return -EINVAL;
-    }
-
     if ((callbackInfo->mStreamAttributes.type == PAL_STREAM_NON_TUNNEL) &&
         ((eventId == PAL_STREAM_CBK_EVENT_READ_DONE) ||
          (eventId == PAL_STREAM_CBK_EVENT_WRITE_READY))) {
+        if (!AIBinder_isAlive(callbackBinder->asBinder().get())) {
+            ALOGW("callback binder has died");
+            return -EINVAL;
+        }
+
         PalCallbackBuffer *rwDonePayload = NULL;
         std::vector<PalCallbackBuffer> rwDonePayloadAidl;
         struct pal_event_read_write_done_payload *rw_done_payload;
-        int fdToBeClosed = -1;
-        int inputFd = -1;
 
         rw_done_payload = (struct pal_event_read_write_done_payload *)eventData;
-        /*
-         * Find the original fd that was passed by client based on what
-         * input and dup fd list and send that back.
-         */
         int dupFd = rw_done_payload->buff.alloc_info.alloc_handle;
-        inputFd = sPalServerWrapper->removeSharedMemoryFdPairs(int64_t(handle), dupFd);
-        if (inputFd != -1) fdToBeClosed = dupFd;
 
         rwDonePayloadAidl.resize(sizeof(pal_callback_buffer));
         rwDonePayload = (PalCallbackBuffer *)rwDonePayloadAidl.data();
@@ -349,7 +412,7 @@ int32_t ClientInfo::onCallback(pal_stream_handle_t *handle, uint32_t eventId, ui
             memcpy(rwDonePayload->buffer.data(), rw_done_payload->buff.buffer, rwDonePayload->size);
         }
 
-        ALOGV("fd [input %d - dup %d]", inputFd, rw_done_payload->buff.alloc_info.alloc_handle);
+        ALOGV("fd [dup %d] done", dupFd);
         if (!callbackInfo->mDataMQ && !callbackInfo->mCommandMQ) {
             if (callbackInfo->prepareMQForTransfer((int64_t)handle, callbackInfo->mClientData)) {
                 ALOGE("MQ prepare failed for stream %p", handle);
@@ -359,22 +422,191 @@ int32_t ClientInfo::onCallback(pal_stream_handle_t *handle, uint32_t eventId, ui
                                                   (int8_t *)rwDonePayload,
                                                   sizeof(PalCallbackBuffer));
 
-        if (fdToBeClosed != -1) {
-            ALOGV("closing dup fd %d ", fdToBeClosed);
-            close(fdToBeClosed);
+        if (callbackInfo->mStreamInfo) callbackInfo->mStreamInfo->releaseSharedBuffer(dupFd);
+    } else {
+        auto dispatcher = callbackInfo->mDispatcher.lock();
+        auto self = callbackInfo->weak_from_this().lock();
+        if (dispatcher && self) {
+            dispatcher->dispatch(self, (int64_t)handle, eventId, eventData, eventDataSize);
         } else {
-            ALOGE("Error finding fd %d", rw_done_payload->buff.alloc_info.alloc_handle);
+            std::vector<uint8_t> payload(eventDataSize, 0);
+            memcpy(payload.data(), eventData, eventDataSize);
+            CallbackDispatcher::send(callbackInfo, (int64_t)handle, eventId, payload);
         }
+    }
+    return 0;
+}
+
+CallbackDispatcher::CallbackDispatcher(int pid) : mPid(pid) {
+    mEventFd = eventfd(0, EFD_CLOEXEC);
+    if (mEventFd < 0) {
+        ALOGE("%s: eventfd failed for pid %d, errno %d", __func__, pid, errno);
+        return;
+    }
+    mSender = std::thread(&CallbackDispatcher::senderLoop, this);
+}
+
+CallbackDispatcher::~CallbackDispatcher() {
+    stop();
+}
+
+void CallbackDispatcher::stop() {
+    Event event;
+
+    if (mExit.exchange(true)) return;
+
+    wake();
+    if (mSender.joinable()) mSender.join();
+    // client is going away, pending events are not delivered
+    while (mQueue.pop(event)) event = Event();
+    {
+        std::lock_guard<std::mutex> lock(mOverflowLock);
+        mOverflowList.clear();
+    }
+    if (mEventFd >= 0) {
+        close(mEventFd);
+        mEventFd = -1;
+    }
+    ALOGI("%s pid %d events queued %llu coalesced %llu overflow %llu max depth %zu", __func__,
+          mPid, (unsigned long long)mQueued.load(), (unsigned long long)mCoalesced.load(),
+          (unsigned long long)mOverflow.load(), mMaxDepth.load());
+}
+
+void CallbackDispatcher::wake() {
+    uint64_t val = 1;
+
+    if (mEventFd >= 0 && write(mEventFd, &val, sizeof(val)) < 0)
+        ALOGE("%s: eventfd write failed, errno %d", __func__, errno);
+}
+
+void CallbackDispatcher::send(CallbackInfo *callbackInfo, int64_t handle, uint32_t eventId,
+                              const std::vector<uint8_t> &payload) {
+    IPALCallback *callbackBinder = callbackInfo->mCallback.get();
+
+    if (!AIBinder_isAlive(callbackBinder->asBinder().get())) {
+        ALOGW("callback binder has died");
+        return;
+    }
+
+    auto status = callbackBinder->eventCallback(handle, eventId, payload.size(), payload,
+                                                callbackInfo->mClientData);
+    if (!status.isOk()) {
+        ALOGE("%s: HIDL call failed during event_callback", __func__);
+    }
+}
+
+/*
+ * Errors and drain acks are delivered one for one, the client waits on each
+ * of them. Other events carry state, only the latest one matters.
+ */
+bool CallbackDispatcher::isCoalescable(uint32_t eventId) {
+    switch (eventId) {
+        case PAL_STREAM_CBK_EVENT_ERROR:
+        case PAL_STREAM_CBK_EVENT_DRAIN_READY:
+        case PAL_STREAM_CBK_EVENT_PARTIAL_DRAIN_READY:
+            return false;
+        default:
+            return true;
+    }
+}
+
+void CallbackDispatcher::sendEvent(Event &event) {
+    std::vector<uint8_t> latest;
+
+    if (!event.coalesced) {
+        send(event.callbackInfo.get(), event.handle, event.eventId, event.payload);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(event.callbackInfo->mPendingLock);
+        auto it = event.callbackInfo->mPendingEvents.find(event.eventId);
+        if (it == event.callbackInfo->mPendingEvents.end()) return;
+        latest = std::move(it->second);
+        event.callbackInfo->mPendingEvents.erase(it);
+    }
+    send(event.callbackInfo.get(), event.handle, event.eventId, latest);
+}
+
+void CallbackDispatcher::dispatch(const std::shared_ptr<CallbackInfo> &callbackInfo,
+                                  int64_t handle, uint32_t eventId, const uint32_t *eventData,
+                                  uint32_t eventDataSize) {
+    Event event;
+    const uint8_t *data = (const uint8_t *)eventData;
+    size_t depth = 0;
+    size_t maxDepth = 0;
+
+    if (mExit) return;
+
+    event.callbackInfo = callbackInfo;
+    event.handle = handle;
+    event.eventId = eventId;
+
+    if (isCoalescable(eventId)) {
+        std::lock_guard<std::mutex> lock(callbackInfo->mPendingLock);
+        auto it = callbackInfo->mPendingEvents.find(eventId);
+        if (it != callbackInfo->mPendingEvents.end()) {
+            // an event of this id is still queued, it goes out with this payload
+            it->second.assign(data, data + eventDataSize);
+            mCoalesced++;
+            return;
+        }
+        callbackInfo->mPendingEvents.emplace(eventId,
+                                             std::vector<uint8_t>(data, data + eventDataSize));
+        event.coalesced = true;
+    } else {
+        event.payload.assign(data, data + eventDataSize);
+    }
+    event.seq = mSeq.fetch_add(1, std::memory_order_relaxed);
+
+    if (!mQueue.push(std::move(event))) {
+        std::lock_guard<std::mutex> lock(mOverflowLock);
+        mOverflowList.push_back(std::move(event));
+        if (mOverflow++ == 0)
+            ALOGW("%s: pid %d queue full, event %u of stream %llx held in overflow list",
+                  __func__, mPid, eventId, (long long)handle);
     } else {
-        std::vector<uint8_t> payload(eventDataSize, 0);
-        memcpy(payload.data(), eventData, eventDataSize);
-        auto status = callbackBinder->eventCallback((int64_t)handle, eventId, eventDataSize,
-                                                    payload, callbackInfo->mClientData);
-        if (!status.isOk()) {
-            ALOGE("%s: HIDL call failed during event_callback", __func__);
+        depth = mQueue.depth();
+        maxDepth = mMaxDepth.load(std::memory_order_relaxed);
+        while (depth > maxDepth && !mMaxDepth.compare_exchange_weak(maxDepth, depth)) {
         }
     }
-    return 0;
+    mQueued++;
+    wake();
+}
+
+void CallbackDispatcher::senderLoop() {
+    Event event;
+    std::deque<Event> overflow;
+    bool haveEvent = false;
+    uint64_t val = 0;
+
+    ALOGV("%s: enter pid %d", __func__, mPid);
+    PalThreadPolicy::apply(PalThreadPolicy::IPC_CALLBACK);
+    while (!mExit) {
+        if (read(mEventFd, &val, sizeof(val)) < 0 && errno != EINTR) {
+            ALOGE("%s: eventfd read failed, errno %d", __func__, errno);
+            break;
+        }
+        while (!mExit) {
+            if (!haveEvent) haveEvent = mQueue.pop(event);
+            if (overflow.empty()) {
+                std::lock_guard<std::mutex> lock(mOverflowLock);
+                overflow.swap(mOverflowList);
+            }
+            if (!haveEvent && overflow.empty()) break;
+            // deliver in dispatch order across the queue and the overflow list
+            if (haveEvent && (overflow.empty() || event.seq < overflow.front().seq)) {
+                sendEvent(event);
+                event = Event();
+                haveEvent = false;
+            } else {
+                sendEvent(overflow.front());
+                overflow.pop_front();
+            }
+        }
+    }
+    ALOGV("%s: exit pid %d", __func__, mPid);
 }
 
 int32_t CallbackInfo::prepareMQForTransfer(int64_t handle, int64_t cookie) {
@@ -458,26 +690,12 @@ void PalServerWrapper::removeStreamHandle(int64_t handle) {
     client->removeStreamHandle(handle);
 }
 
-void PalServerWrapper::addSharedMemoryFdPairs(int64_t handle, int inputFd, int dupFd) {
+int PalServerWrapper::importSharedBuffer(int64_t handle, int clientFd, int binderFd) {
     std::lock_guard<std::mutex> guard(mLock);
-    ALOGV("%s, caller handle %llx inputFd %d dupFd %d", __func__, handle, inputFd, dupFd);
+    ALOGV("%s, caller handle %llx clientFd %d", __func__, handle, clientFd);
 
     auto client = getClient_l();
-    client->addSharedMemoryFdPairs(handle, inputFd, dupFd);
-}
-
-int PalServerWrapper::removeSharedMemoryFdPairs(int64_t handle, int dupFd) {
-    std::lock_guard<std::mutex> guard(mLock);
-    int inputFd;
-    int ret = -1;
-    ALOGV("%s, caller handle %llx  dupFd %d", __func__, handle, dupFd);
-
-    for (auto &client : mClients) {
-        auto &clientInfoObj = client.second;
-        inputFd = clientInfoObj->removeSharedMemoryFdPairs(handle, dupFd);
-        if (inputFd != -1) ret = inputFd;
-    }
-    return ret;
+    return client->importSharedBuffer(handle, clientFd, binderFd);
 }
 
 bool PalServerWrapper::isValidStreamHandle(int64_t handle) {
@@ -570,6 +788,7 @@ std::shared_ptr<ClientInfo> PalServerWrapper::getClient_l() {
     }
 
     callBackInfo->setStreamAttr(palAttr.get());
+    callBackInfo->setDispatcher(client->getDispatcher());
 
     ret = pal_stream_open(palAttr.get(), devs.size(), palDev.get(), modskv.size(), modifiers.get(),
                           callback, (int64_t)callBackInfo.get(), &handle);
@@ -578,6 +797,7 @@ std::shared_ptr<ClientInfo> PalServerWrapper::getClient_l() {
     if (!ret) {
         addStreamHandle((int64_t)handle);
         callBackInfo->setHandle((int64_t)handle);
+        callBackInfo->setStreamInfo(client->getStreamInfo((int64_t)handle));
         client->registerCallback((int64_t)handle, cb, callBackInfo);
     }
     return status_tToBinderResult(ret);
@@ -725,10 +945,10 @@ std::shared_ptr<ClientInfo> PalServerWrapper::getClient_l() {
 
     auto metadataParser = std::make_unique<MetadataParser>();
     metadataParser->fillMetaData(buf.metadata, buf.frame_index, buf.size, mediaConfig.get());
-    auto fdInfo = AidlToLegacy::getFdIntFromNativeHandle(inBuf.data()->allocInfo.allocHandle);
+    auto fdInfo = AidlToLegacy::getFdIntFromNativeHandle(inBuf.data()->allocInfo.allocHandle,
+                                                         false);
 
-    buf.alloc_info.alloc_handle = fdInfo.first;
-    addSharedMemoryFdPairs(handle, fdInfo.second, buf.alloc_info.alloc_handle);
+    buf.alloc_info.alloc_handle = importSharedBuffer(handle, fdInfo.second, fdInfo.first);
 
     ALOGV("%s: fd[input%d - dup%d]", __func__, fdInfo.second, buf.alloc_info.alloc_handle);
     buf.alloc_info.alloc_size = inBuf.data()->allocInfo.allocSize;
@@ -764,10 +984,10 @@ std::shared_ptr<ClientInfo> PalServerWrapper::getClient_l() {
     buf.buffer = dataBuffer.data();
 
     buf.metadata_size = MetadataParser::READ_METADATA_MAX_SIZE();
-    auto fdHandle = AidlToLegacy::getFdIntFromNativeHandle(inBuf.data()->allocInfo.allocHandle);
+    auto fdHandle = AidlToLegacy::getFdIntFromNativeHandle(inBuf.data()->allocInfo.allocHandle,
+                                                           false);
 
-    buf.alloc_info.alloc_handle = (fdHandle.first);
-    addSharedMemoryFdPairs(handle, fdHandle.second, buf.alloc_info.alloc_handle);
+    buf.alloc_info.alloc_handle = importSharedBuffer(handle, fdHandle.second, fdHandle.first);
     ALOGV("%s: fd[input%d - dup%d]", __func__, fdHandle.second, buf.alloc_info.alloc_handle);
 
     buf.alloc_info.alloc_size = inBuf.data()->allocInfo.allocSize;
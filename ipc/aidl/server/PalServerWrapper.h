@@ -9,9 +9,15 @@
 #include <fmq/EventFlag.h>
 #include <log/log.h>
 #include <utils/Thread.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <mutex>
+#include <sys/stat.h>
+#include <thread>
 #include <unordered_map>
 #include "PalApi.h"
+#include "PalLockFreeQueue.h"
 
 using ::android::AidlMessageQueue;
 using ::aidl::android::hardware::common::fmq::SynchronizedReadWrite;
@@ -27,20 +33,96 @@ class StreamInfo {
     using FdPair = std::pair<int, int>;
     std::vector<FdPair> mInOutFdPairs;
 
+    /*
+     * Client buffers registered for the lifetime of the stream. A client
+     * buffer is identified by the fd number in the client process and
+     * validated against the inode of the fd received over binder.
+     */
+    struct BufferSlot {
+        int clientFd;
+        int dupFd;
+        dev_t dev;
+        ino_t ino;
+        uint32_t inFlight;
+    };
+    std::vector<BufferSlot> mBufferSlots;
+    std::unordered_map<int /* client fd */, size_t> mSlotByClientFd;
+    std::unordered_map<int /* dup fd */, size_t> mSlotByDupFd;
+
+    void addSharedMemoryFdPairs_l(int input, int dupFd);
+    // remove the Fd and return input fd for this.
+    int removeSharedMemoryFdPairs_l(int dupFd);
+
   public:
     StreamInfo(int64_t handle) : mHandle(handle) {
         ALOGI("StreamInfo created for handle %llx", mHandle);
     }
     ~StreamInfo();
 
-    void addSharedMemoryFdPairs(int input, int dupFd);
-    // remove the Fd and return input fd for this.
-    int removeSharedMemoryFdPairs(int dupFd);
+    // returns the server side fd to hand to PAL for a client buffer
+    int importSharedBuffer(int clientFd, int binderFd);
+    // called when PAL is done with a buffer (READ_DONE/WRITE_READY)
+    void releaseSharedBuffer(int dupFd);
     void closeSharedMemoryFdPairs();
     void forceCloseStream();
 };
 
-class CallbackInfo {
+class CallbackInfo;
+
+/*
+ * Per client sender of non data stream events. PAL event threads only
+ * enqueue, the binder call into the client is made from the sender thread
+ * so that a slow client does not stall PAL event delivery for all streams.
+ */
+class CallbackDispatcher {
+  public:
+    struct Event {
+        std::shared_ptr<CallbackInfo> callbackInfo;
+        int64_t handle = 0;
+        uint32_t eventId = 0;
+        // dispatch order, used to merge the queue with the overflow list
+        uint64_t seq = 0;
+        // payload is held in mPendingEvents of callbackInfo
+        bool coalesced = false;
+        std::vector<uint8_t> payload;
+    };
+
+    CallbackDispatcher(int pid);
+    ~CallbackDispatcher();
+    void dispatch(const std::shared_ptr<CallbackInfo> &callbackInfo, int64_t handle,
+                  uint32_t eventId, const uint32_t *eventData, uint32_t eventDataSize);
+    void stop();
+    static void send(CallbackInfo *callbackInfo, int64_t handle, uint32_t eventId,
+                     const std::vector<uint8_t> &payload);
+
+  private:
+    static constexpr size_t kQueueSize = 64;
+
+    static bool isCoalescable(uint32_t eventId);
+    void senderLoop();
+    void sendEvent(Event &event);
+    void wake();
+
+    int mPid;
+    int mEventFd = -1;
+    std::atomic<bool> mExit{false};
+    std::thread mSender;
+    PalLockFreeQueue<Event, kQueueSize> mQueue;
+    /*
+     * Events that did not fit in mQueue. PAL threads never wait for the
+     * sender, and since state events are coalesced per stream and event id
+     * the list only grows with events that must all be delivered.
+     */
+    std::mutex mOverflowLock;
+    std::deque<Event> mOverflowList;
+    std::atomic<uint64_t> mSeq{0};
+    std::atomic<uint64_t> mQueued{0};
+    std::atomic<uint64_t> mCoalesced{0};
+    std::atomic<uint64_t> mOverflow{0};
+    std::atomic<size_t> mMaxDepth{0};
+};
+
+class CallbackInfo : public std::enable_shared_from_this<CallbackInfo> {
     typedef ::android::AidlMessageQueue<
             int8_t, ::aidl::android::hardware::common::fmq::SynchronizedReadWrite>
             DataMQ;
@@ -57,6 +139,15 @@ class CallbackInfo {
     EventFlag *mEfGroup = nullptr;
     std::shared_ptr<IPALCallback> mCallback;
     struct pal_stream_attributes mStreamAttributes;
+    std::shared_ptr<StreamInfo> mStreamInfo;
+    std::weak_ptr<CallbackDispatcher> mDispatcher;
+    /*
+     * Latest payload per event id of state events queued but not yet sent
+     * to the client. A newer event of the same id replaces the payload
+     * instead of queueing another event.
+     */
+    std::mutex mPendingLock;
+    std::unordered_map<uint32_t, std::vector<uint8_t>> mPendingEvents;
     CallbackInfo(const std::shared_ptr<IPALCallback> &callback, int64_t clientData) {
         mCallback = callback;
         mClientData = clientData;
@@ -74,6 +165,10 @@ class CallbackInfo {
         memcpy(&mStreamAttributes, attr, sizeof(mStreamAttributes));
     }
     void setHandle(int64_t handle) { mHandle = handle; }
+    void setStreamInfo(std::shared_ptr<StreamInfo> streamInfo) { mStreamInfo = streamInfo; }
+    void setDispatcher(const std::shared_ptr<CallbackDispatcher> &dispatcher) {
+        mDispatcher = dispatcher;
+    }
     int32_t callReadWriteTransferThread(PalReadWriteDoneCommand cmd, const int8_t *data,
                                         size_t dataSize);
     int32_t prepareMQForTransfer(int64_t handle, int64_t cookie);
@@ -89,8 +184,7 @@ class IStreamOps {
   public:
     virtual void addStreamHandle(int64_t handle) = 0;
     virtual void removeStreamHandle(int64_t handle) = 0;
-    virtual void addSharedMemoryFdPairs(int64_t handle, int input, int dupFd) = 0;
-    virtual int removeSharedMemoryFdPairs(int64_t handle, int dupFd) = 0;
+    virtual int importSharedBuffer(int64_t handle, int clientFd, int binderFd) = 0;
     virtual bool isValidStreamHandle(int64_t handle) = 0;
     virtual ~IStreamOps() = default;
 };
@@ -99,6 +193,7 @@ class PalServerWrapper;
 
 class ClientInfo : public IStreamOps {
     std::vector<std::shared_ptr<CallbackInfo>> mCallbackInfo;
+    std::shared_ptr<CallbackDispatcher> mDispatcher;
 
     int mPid = 0;
     std::mutex mCallbackLock;
@@ -127,13 +222,14 @@ class ClientInfo : public IStreamOps {
     std::shared_ptr<StreamInfo> getStreamInfo_l(int64_t handle);
 
     void clearCallbacks();
+    // created on first use, shared by all streams of this client
+    std::shared_ptr<CallbackDispatcher> getDispatcher();
     void clearStreams();
     void addStreamHandle(int64_t handle);
     void removeStreamHandle(int64_t handle);
-    void addSharedMemoryFdPairs(int64_t handle, int input, int dupFd) override;
-    // remove the Fd and return input fd for this.
-    int removeSharedMemoryFdPairs(int64_t handle, int dupFd) override;
+    int importSharedBuffer(int64_t handle, int clientFd, int binderFd) override;
     bool isValidStreamHandle(int64_t handle);
+    std::shared_ptr<StreamInfo> getStreamInfo(int64_t handle);
     void closeSharedMemoryFdPairs(int64_t handle);
     void registerCallback(int64_t handle, const std::shared_ptr<IPALCallback> &callback,
                           std::shared_ptr<CallbackInfo> callBackInfo);
@@ -215,9 +311,7 @@ class PalServerWrapper : public BnPAL, public IStreamOps {
     void addStreamHandle(int64_t handle) override;
     void removeStreamHandle(int64_t handle) override;
 
-    void addSharedMemoryFdPairs(int64_t handle, int input, int dupFd) override;
-    // remove the Fd and return input fd for this.
-    int removeSharedMemoryFdPairs(int64_t handle, int dupFd) override;
+    int importSharedBuffer(int64_t handle, int clientFd, int binderFd) override;
     bool isValidStreamHandle(int64_t handle) override;
 
     // it returns the client as per caller pid, must be called with lock held
@@ -64,6 +64,7 @@
 #include "SoundTriggerPlatformInfo.h"
 #include "SignalHandler.h"
 #include "MemLogBuilder.h"
+#include "PalReactor.h"
 
 typedef int32_t (*voiceuiDmgrCallback)(int32_t, void *, size_t);
 
@@ -112,6 +113,10 @@ typedef enum {
 #define AUDIO_PARAMETER_KEY_MAX_SESSIONS "max_sessions"
 #define AUDIO_PARAMETER_KEY_MAX_NT_SESSIONS "max_nonTunnel_sessions"
 #define AUDIO_PARAMETER_KEY_LOG_LEVEL "logging_level"
+#define AUDIO_PARAMETER_KEY_LOG_DUMP "pal_log_dump"
+#define PAL_BINLOG_DUMP_DIR "/data/vendor/audio"
+#define AUDIO_PARAMETER_KEY_THREAD_POLICY_DUMP "pal_thread_policy_dump"
+#define AUDIO_PARAMETER_KEY_ST_BUFFER_POOL_DUMP "pal_st_buffer_pool_dump"
 #define AUDIO_PARAMETER_KEY_CONTEXT_MANAGER_ENABLE "context_manager_enable"
 #define AUDIO_PARAMETER_KEY_HIFI_FILTER "hifi_filter"
 #define AUDIO_PARAMETER_KEY_LPI_LOGGING "lpi_logging_enable"
@@ -127,6 +132,7 @@ typedef enum {
 #define AUDIO_PARAMETER_KEY_DUMMY_DEV_ENABLE "dummy_dev_enable"
 #define AUDIO_PARAMETER_MULTI_SR_COMBO_SUPPORTED "multiple_sample_rate_combo_supported"
 #define AUDIO_PARAMETER_KEY_PAL_SSR_TRIGGER_ENABLE "ssr_trigger_in_pal"
+#define AUDIO_PARAMETER_KEY_ASYNC_PARAM_UPDATE "async_param_update"
 #define MAX_PCM_NAME_SIZE 50
 #define MAX_STREAM_INSTANCES (sizeof(uint64_t) << 3)
 #define MIN_USECASE_PRIORITY 0xFFFFFFFF
@@ -381,6 +387,17 @@ struct tx_ecinfo {
     std::vector<int> disabled_rx_streams;
 };
 
+/* sound trigger concurrency rule for one stream type and direction,
+ * resolved from the platform xml flags at init */
+struct st_conc_rule {
+    bool rx_conc;
+    bool tx_conc;
+    bool conc_en;
+    bool conc_en_crs;    /* conc_en while a CRS call is active */
+    bool nlpi_tx_conc;   /* tx_conc only when the stream is in NLPI */
+    const char *name;
+};
+
 enum {
     NATIVE_AUDIO_MODE_SRC = 1,
     NATIVE_AUDIO_MODE_TRUE_44_1,
@@ -645,6 +662,13 @@ protected:
     static std::map<int, std::string> spkrTempCtrlsMap;
     static std::map<uint32_t, uint32_t> btSlimClockSrcMap;
     static std::vector<deviceIn> deviceInfo;
+    /* resolved getDeviceInfo() results keyed by device, stream type and
+     * custom key, dropped whenever the xml tables are (re)parsed */
+    static std::map<std::tuple<int32_t, int32_t, std::string>, struct pal_device_info> deviceInfoCache;
+    static std::mutex deviceInfoCacheMutex;
+    static void invalidateDeviceInfoCache();
+    bool resolveDeviceInfo(pal_device_id_t deviceId, pal_stream_type_t type,
+                           const std::string &key, struct pal_device_info *devinfo);
     static std::vector<tx_ecinfo> txEcInfo;
     static struct vsid_info vsidInfo;
     static struct volume_set_param_info volumeSetParamInfo_;
@@ -666,6 +690,7 @@ protected:
     static int ACDConcurrencyDisableCount;
     static int ASRConcurrencyDisableCount;
     static int SNSPCMDataConcurrencyDisableCount;
+    struct st_conc_rule stConcRules[PAL_STREAM_MAX][PAL_AUDIO_INPUT_OUTPUT + 1];
     static defer_switch_state_t deferredSwitchState;
     static int wake_lock_fd;
     static int wake_unlock_fd;
@@ -674,15 +699,15 @@ protected:
     std::map<int, std::pair<session_callback, uint64_t>> mixerEventCallbackMap;
     static std::thread mixerEventTread;
     /*
-     * Thread to handle deferred switch, only applicable
+     * Reactor timer to handle deferred switch, only applicable
      * when low latency bargein is enabled.
      */
-    static std::thread vui_deferred_switch_thread_;
-    static std::condition_variable vui_switch_cv_;
     static std::mutex vui_switch_mutex_;
-    static bool vui_switch_thread_exit_;
-    static int deferred_switch_cnt_;
-    static void voiceUIDeferredSwitchLoop(std::shared_ptr<ResourceManager> rm);
+    static PalReactor::TimerId vui_switch_timer_;
+    static uint32_t vui_switch_gen_;
+    void armDeferredSwitch_l();
+    void cancelDeferredSwitch_l();
+    void onDeferredSwitchTimeout(uint32_t gen);
     std::shared_ptr<CaptureProfile> SoundTriggerCaptureProfile;
     std::shared_ptr<CaptureProfile> TXMacroCaptureProfile;
     ResourceManager();
@@ -729,6 +754,8 @@ public:
     static bool isDummyDevEnabled;
     static bool isProxyRecordActive;
     static bool isPalSsrTriggerEnabled;
+    /* Flag to indicate if volume/mute updates are coalesced and flushed asynchronously */
+    static bool isAsyncParamUpdateEnabled;
     static std::mutex mChargerBoostMutex;
     /* Variable to store which speaker side is being used for call audio.
      * Valid for Stereo case only
@@ -737,6 +764,7 @@ public:
     static bool isMainSpeakerRight;
     /* Variable to store Quick calibration time for Speaker protection */
     static int spQuickCalTime;
+    static int spViIdleHoldMs;
     /* Variable to store the mode request for Speaker protection */
     pal_spkr_prot_payload mSpkrProtModeValue;
 
@@ -1009,6 +1037,8 @@ public:
     int handleMixerEvent(struct mixer *mixer, char *mixer_str);
     int StopOtherDetectionStreams(void *st);
     int StartOtherDetectionStreams(void *st);
+    bool SharesCaptureBackend(Stream *s1, Stream *s2);
+    void compileSTConcurrencyRules();
     void GetConcurrencyInfo(Stream* s,
                          bool *rx_conc, bool *tx_conc, bool *conc_en);
     void ConcurrentStreamStatus(Stream* s, bool active);
@@ -1076,6 +1106,7 @@ public:
     static void setConnectivityProxyEnableParam(struct str_parms *parms,char *value, int len);
     static void setDummyDevEnableParam(struct str_parms *parms, char *value, int len);
     static void setPalSsrTriggerParam(struct str_parms *parms,char *value, int len);
+    static void setAsyncParamUpdateParam(struct str_parms *parms, char *value, int len);
     static bool isLpiLoggingEnabled();
     static void processConfigParams(const XML_Char **attr);
     static bool isValidDevId(int deviceId);
@@ -30,7 +30,9 @@
 #ifndef SNDCARD_MONITOR_H
 #define SNDCARD_MONITOR_H
 #include <list>
+#include <mutex>
 #include "PalDefs.h"
+#include "PalReactor.h"
 
 typedef struct {
     int card;
@@ -41,8 +43,13 @@ typedef struct {
 class SndCardMonitor
 {
 private :
-    std::thread mThread;
-    void monitorThreadLoop();
+    int mFd;
+    int mTries;
+    bool mExit;
+    std::mutex mMutex;
+    PalReactor::TimerId mRetryTimer;
+    void openNode();
+    void onCardStateEvent(uint32_t events);
 
 public :
     SndCardMonitor(int sndNum);
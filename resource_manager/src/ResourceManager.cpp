@@ -71,6 +71,7 @@
 #include "DisplayPort.h"
 #include "Handset.h"
 #include "SndCardMonitor.h"
+#include "ThermalCalService.h"
 #include "UltrasoundDevice.h"
 #include "ECRefDevice.h"
 #include "HapticsDev.h"
@@ -79,6 +80,9 @@
 #include "kvh2xml.h"
 
 #include "PerfLock.h"
+#include "PalThreadPolicy.h"
+#include "PalBufferTuner.h"
+#include "PalRingBuffer.h"
 
 #ifndef FEATURE_IPQ_OPENWRT
 #include <cutils/str_parms.h>
@@ -168,7 +172,6 @@ int VUISetParameters(uint32_t param_id, void *param_payload,
 #define WAIT_RECOVER_FET 150000
 
 #define NLPI_LPI_SWITCH_DELAY_SEC 5
-#define NLPI_LPI_SWITCH_SLEEP_INTERVAL_SEC 1
 
 /*this can be over written by the config file settings*/
 uint32_t pal_log_lvl = (PAL_LOG_ERR|PAL_LOG_INFO);
@@ -536,11 +539,9 @@ int ResourceManager::ACDConcurrencyDisableCount = 0;
 int ResourceManager::ASRConcurrencyDisableCount = 0;
 int ResourceManager::SNSPCMDataConcurrencyDisableCount = 0;
 defer_switch_state_t ResourceManager::deferredSwitchState = NO_DEFER;
-std::thread ResourceManager::vui_deferred_switch_thread_;
-std::condition_variable ResourceManager::vui_switch_cv_;
 std::mutex ResourceManager::vui_switch_mutex_;
-bool ResourceManager::vui_switch_thread_exit_ = false;
-int ResourceManager::deferred_switch_cnt_ = -1;
+PalReactor::TimerId ResourceManager::vui_switch_timer_ = 0;
+uint32_t ResourceManager::vui_switch_gen_ = 0;
 int ResourceManager::wake_lock_fd = -1;
 int ResourceManager::wake_unlock_fd = -1;
 uint32_t ResourceManager::wake_lock_cnt = 0;
@@ -557,6 +558,7 @@ bool ResourceManager::isRasEnabled = false;
 bool ResourceManager::is_multiple_sample_rate_combo_supported = true;
 bool ResourceManager::isMainSpeakerRight;
 int ResourceManager::spQuickCalTime;
+int ResourceManager::spViIdleHoldMs = 0;
 bool ResourceManager::isGaplessEnabled = false;
 bool ResourceManager::isDualMonoEnabled = false;
 bool ResourceManager::isUHQAEnabled = false;
@@ -572,6 +574,7 @@ bool ResourceManager::isCPEnabled = false;
 bool ResourceManager::isDummyDevEnabled = false;
 bool ResourceManager::isProxyRecordActive = false;
 bool ResourceManager::isPalSsrTriggerEnabled = false;
+bool ResourceManager::isAsyncParamUpdateEnabled = false;
 pal_audio_event_callback ResourceManager::callback_event = nullptr;
 bool ResourceManager::isSilenceDetectionEnabledPcm = false;
 bool ResourceManager::isSilenceDetectionEnabledVoice = false;
@@ -608,6 +611,8 @@ void str_parms_destroy(struct str_parms *str_parms){return;}
 
 std::vector<vote_type_t> ResourceManager::sleep_monitor_vote_type_(PAL_STREAM_MAX, NLPI_VOTE);
 std::vector<deviceIn> ResourceManager::deviceInfo;
+std::map<std::tuple<int32_t, int32_t, std::string>, struct pal_device_info> ResourceManager::deviceInfoCache;
+std::mutex ResourceManager::deviceInfoCacheMutex;
 std::vector<tx_ecinfo> ResourceManager::txEcInfo;
 std::vector <uint32_t> sndCardStandbySupportedStreams_;
 struct vsid_info ResourceManager::vsidInfo;
@@ -860,6 +865,7 @@ void ResourceManager::sendCrashSignal(int signal, pid_t pid, uid_t uid)
 {
     PAL_DBG(LOG_TAG, "%s: signal %d, pid %u, uid %u", __func__, signal, pid, uid);
 #ifndef PAL_MEMLOG_UNSUPPORTED
+    palStateFlush(true);
     int32_t ret = memLoggerDumpAllToFile();
     if (ret)
     {
@@ -931,6 +937,8 @@ ResourceManager::ResourceManager()
         throw std::runtime_error("error in resource xml parsing");
     }
 
+    compileSTConcurrencyRules();
+
     if (IsVirtualPortForUPDEnabled()) {
         updateVirtualBackendName();
         updateVirtualBESndName();
@@ -1073,6 +1081,7 @@ ResourceManager::ResourceManager()
         } else {
             PAL_INFO(LOG_TAG, "hapticsconfig xml parsing successful");
         }
+        PayloadBuilder::compileHapticsEffects();
     }
 
     PAL_DBG(LOG_TAG, "Creating ContextManager");
@@ -1091,6 +1100,7 @@ ResourceManager::~ResourceManager()
 {
 #ifndef PAL_MEMLOG_UNSUPPORTED
     // Dump memory logger queues
+    palStateFlush(false);
     int ret = memLoggerDumpAllToFile();
     if (ret)
     {
@@ -1424,6 +1434,8 @@ void ResourceManager::ssrHandlingLoop(std::shared_ptr<ResourceManager> rm)
             mActiveStreamMutex.lock();
             rm->cardState = state;
             if (state != prevState) {
+                // the card may come back with a different set of controls
+                ThermalCalService::getInstance()->invalidateMixer(nullptr);
                 if (rm->globalCb) {
                     PAL_DBG(LOG_TAG, "Notifying client about sound card state %d global cb %pK",
                                       rm->cardState, rm->globalCb);
@@ -1643,6 +1655,7 @@ int ResourceManager::init_audio()
         PAL_ERR(LOG_TAG, "Error: %d virtual audio mixer open failure", -EIO);
         if (snd_card_name)
             free(snd_card_name);
+        ThermalCalService::getInstance()->invalidateMixer(audio_hw_mixer);
         mixer_close(audio_hw_mixer);
         return -EIO;
     }
@@ -1680,6 +1693,7 @@ int ResourceManager::init_audio()
         PAL_INFO(LOG_TAG, "audio route %pK, mixer path %s", audio_route, mixer_xml_file_wo_variant);
     if (!audio_route) {
             PAL_ERR(LOG_TAG, "audio route init failed ");
+            ThermalCalService::getInstance()->invalidateMixer(audio_hw_mixer);
             mixer_close(audio_virt_mixer);
             mixer_close(audio_hw_mixer);
             status = -EINVAL;
@@ -2056,10 +2070,6 @@ int ResourceManager::init()
     struct pal_device dattr;
 
     mixerEventTread = std::thread(mixerEventWaitThreadLoop, rm);
-    if (rm && rm->IsLowLatencyBargeinSupported()) {
-        vui_deferred_switch_thread_ = std::thread(
-            ResourceManager::voiceUIDeferredSwitchLoop, rm);
-    }
 
     //Initialize audio_charger_listener
     if (rm && isChargeConcurrencyEnabled)
@@ -2543,12 +2553,42 @@ bool ResourceManager::getEcRefStatus(pal_stream_type_t tx_streamtype,pal_stream_
     return ecref_status;
 }
 
+void ResourceManager::invalidateDeviceInfoCache()
+{
+    std::lock_guard<std::mutex> lck(deviceInfoCacheMutex);
+    deviceInfoCache.clear();
+}
+
 void ResourceManager::getDeviceInfo(pal_device_id_t deviceId, pal_stream_type_t type, std::string key, struct pal_device_info *devinfo)
+{
+    std::tuple<int32_t, int32_t, std::string> cacheKey(deviceId, type, key);
+
+    {
+        std::lock_guard<std::mutex> lck(deviceInfoCacheMutex);
+        auto it = deviceInfoCache.find(cacheKey);
+        if (it != deviceInfoCache.end()) {
+            *devinfo = it->second;
+            return;
+        }
+    }
+
+    // unknown devices leave devinfo untouched, nothing to cache
+    if (!resolveDeviceInfo(deviceId, type, key, devinfo))
+        return;
+
+    std::lock_guard<std::mutex> lck(deviceInfoCacheMutex);
+    deviceInfoCache[cacheKey] = *devinfo;
+}
+
+bool ResourceManager::resolveDeviceInfo(pal_device_id_t deviceId, pal_stream_type_t type,
+                                        const std::string &key, struct pal_device_info *devinfo)
 {
     bool found = false;
+    bool devFound = false;
 
     for (int32_t i = 0; i < deviceInfo.size(); i++) {
         if (deviceId == deviceInfo[i].deviceId) {
+            devFound = true;
             devinfo->max_channels = deviceInfo[i].max_channel;
             devinfo->channels = deviceInfo[i].channel;
             devinfo->sndDevName = deviceInfo[i].sndDevName;
@@ -2667,6 +2707,8 @@ void ResourceManager::getDeviceInfo(pal_device_id_t deviceId, pal_stream_type_t
             }
         }
     }
+
+    return devFound;
 }
 
 int32_t ResourceManager::getSidetoneMode(pal_device_id_t deviceId,
@@ -4837,13 +4879,6 @@ void ResourceManager::GetSoundTriggerConcurrencyCount(
 void ResourceManager::GetSoundTriggerConcurrencyCount_l(
     pal_stream_type_t type, int32_t *disable_count) {
 
-    pal_stream_attributes st_attr;
-    bool voice_conc_enable = IsVoiceCallConcurrencySupported();
-    bool voip_conc_enable = IsVoipConcurrencySupported();
-    bool audio_capture_conc_enable =
-        IsAudioCaptureConcurrencySupported();
-    bool low_latency_bargein_enable = IsLowLatencyBargeinSupported();
-
     if (type == PAL_STREAM_ACD) {
         *disable_count = ACDConcurrencyDisableCount;
     } else if (type == PAL_STREAM_VOICE_UI) {
@@ -5306,6 +5341,7 @@ void ResourceManager::mixerEventWaitThreadLoop(
     struct ctl_event mixer_event = {0, {.data8 = {0}}};
     struct mixer *mixer = nullptr;
 
+    PalThreadPolicy::apply(PalThreadPolicy::MIXER_EVENT);
     ret = rm->getVirtualAudioMixer(&mixer);
     if (ret) {
         PAL_ERR(LOG_TAG, "Failed to get audio mxier");
@@ -5490,14 +5526,16 @@ int ResourceManager::HandleDetectionStreamAction(pal_stream_type_t type, int32_t
 
         switch (action) {
             case ST_PAUSE:
-                if (str != (Stream *)data) {
+                if (str != (Stream *)data &&
+                    (!data || SharesCaptureBackend(str, (Stream *)data))) {
                     status = str->Pause();
                     if (status)
                         PAL_ERR(LOG_TAG, "Failed to pause stream");
                 }
                 break;
             case ST_RESUME:
-                if (str != (Stream *)data) {
+                if (str != (Stream *)data &&
+                    (!data || SharesCaptureBackend(str, (Stream *)data))) {
                     status = str->Resume();
                     if (status)
                         PAL_ERR(LOG_TAG, "Failed to do resume stream");
@@ -5527,14 +5565,16 @@ int ResourceManager::HandleDetectionStreamAction(pal_stream_type_t type, int32_t
                 }
                 break;
             case ST_INTERNAL_PAUSE:
-                if (str != (Stream *)data) {
+                if (str != (Stream *)data &&
+                    (!data || SharesCaptureBackend(str, (Stream *)data))) {
                     status = str->Pause(true);
                     if (status)
                         PAL_ERR(LOG_TAG, "Internal pause stream failed");
                 }
                 break;
             case ST_INTERNAL_RESUME:
-                if (str != (Stream *)data) {
+                if (str != (Stream *)data &&
+                    (!data || SharesCaptureBackend(str, (Stream *)data))) {
                     status = str->Resume(true);
                     if (status)
                         PAL_ERR(LOG_TAG, "Internal resume stream failed");
@@ -5549,6 +5589,51 @@ int ResourceManager::HandleDetectionStreamAction(pal_stream_type_t type, int32_t
     return status;
 }
 
+/*
+ * Detection streams whose current capture profile uses the tx macro backend
+ * do not share the capture with the va macro ones. A capture profile switch
+ * on one backend only needs to restart the streams on that backend.
+ */
+bool ResourceManager::SharesCaptureBackend(Stream *s1, Stream *s2)
+{
+    Stream *streams[2] = {s1, s2};
+    bool tx_macro[2] = {false, false};
+    struct pal_stream_attributes sAttr;
+    std::shared_ptr<CaptureProfile> cap_prof = nullptr;
+    StreamSoundTrigger *st_st = nullptr;
+    StreamACD *st_acd = nullptr;
+    StreamASR *st_asr = nullptr;
+    StreamSensorPCMData *st_sns_pcm_data = nullptr;
+
+    for (int i = 0; i < 2; i++) {
+        cap_prof = nullptr;
+        if (streams[i]->getStreamAttributes(&sAttr) != 0)
+            continue;
+
+        if (sAttr.type == PAL_STREAM_VOICE_UI) {
+            st_st = dynamic_cast<StreamSoundTrigger*>(streams[i]);
+            if (st_st)
+                cap_prof = st_st->GetCurrentCaptureProfile();
+        } else if (sAttr.type == PAL_STREAM_ACD) {
+            st_acd = dynamic_cast<StreamACD*>(streams[i]);
+            if (st_acd)
+                cap_prof = st_acd->GetCurrentCaptureProfile();
+        } else if (sAttr.type == PAL_STREAM_ASR) {
+            st_asr = dynamic_cast<StreamASR*>(streams[i]);
+            if (st_asr)
+                cap_prof = st_asr->GetCurrentCaptureProfile();
+        } else if (sAttr.type == PAL_STREAM_SENSOR_PCM_DATA) {
+            st_sns_pcm_data = dynamic_cast<StreamSensorPCMData*>(streams[i]);
+            if (st_sns_pcm_data)
+                cap_prof = st_sns_pcm_data->GetCurrentCaptureProfile();
+        }
+
+        tx_macro[i] = cap_prof && cap_prof->GetBackend().compare("tx_macro") == 0;
+    }
+
+    return tx_macro[0] == tx_macro[1];
+}
+
 int ResourceManager::StopOtherDetectionStreams(void *st) {
     HandleDetectionStreamAction(PAL_STREAM_VOICE_UI, ST_INTERNAL_PAUSE, st);
     HandleDetectionStreamAction(PAL_STREAM_ACD, ST_PAUSE, st);
@@ -5565,15 +5650,95 @@ int ResourceManager::StartOtherDetectionStreams(void *st) {
     return 0;
 }
 
+void ResourceManager::compileSTConcurrencyRules()
+{
+    bool voice_conc_enable = false;
+    bool voip_conc_enable = false;
+    bool low_latency_bargein_enable = IsLowLatencyBargeinSupported();
+    bool audio_capture_conc_enable = IsAudioCaptureConcurrencySupported();
+    std::shared_ptr<SoundTriggerPlatformInfo> st_info =
+                SoundTriggerPlatformInfo::GetInstance();
+
+    if (st_info) {
+        voice_conc_enable = st_info->GetConcurrentVoiceCallEnable();
+        voip_conc_enable = st_info->GetConcurrentVoipCallEnable();
+    }
+
+    for (int type = 0; type < PAL_STREAM_MAX; type++) {
+        for (int dir = 0; dir <= PAL_AUDIO_INPUT_OUTPUT; dir++) {
+            struct st_conc_rule *rule = &stConcRules[type][dir];
+
+            memset(rule, 0, sizeof(*rule));
+            rule->conc_en = true;
+            rule->conc_en_crs = true;
+            rule->name = "none";
+
+            if (dir == PAL_AUDIO_OUTPUT) {
+                if (type == PAL_STREAM_LOW_LATENCY && !low_latency_bargein_enable) {
+                    rule->name = "ll playback ignored";
+                } else if (type == PAL_STREAM_SENSOR_PCM_RENDERER ||
+                           type == PAL_STREAM_HAPTICS) {
+                    rule->name = "playback ignored";
+                } else {
+                    rule->rx_conc = true;
+                    rule->name = "playback";
+                }
+            }
+
+            /*
+             * Generally voip/voice rx stream comes with related tx streams,
+             * so there's no need to switch to NLPI for voip/voice rx stream
+             * if corresponding voip/voice tx stream concurrency is not supported.
+             * Also note that capture concurrency has highest proirity that
+             * when capture concurrency is disabled then concurrency for voip
+             * and voice call should also be disabled even voice_conc_enable
+             * or voip_conc_enable is set to true.
+             */
+            if (type == PAL_STREAM_VOICE_CALL) {
+                rule->tx_conc = true;
+                rule->rx_conc = true;
+                rule->conc_en = audio_capture_conc_enable && voice_conc_enable;
+                /* if CRS call allow voice concurrency */
+                rule->conc_en_crs = audio_capture_conc_enable;
+                rule->name = "voice";
+            } else if (type == PAL_STREAM_VOIP_TX) {
+                rule->tx_conc = true;
+                rule->conc_en = audio_capture_conc_enable && voip_conc_enable;
+                rule->conc_en_crs = rule->conc_en;
+                rule->name = "voip";
+            } else if (type == PAL_STREAM_ACD ||
+                       type == PAL_STREAM_SENSOR_PCM_DATA ||
+                       type == PAL_STREAM_VOICE_UI ||
+                       type == PAL_STREAM_ASR) {
+                rule->nlpi_tx_conc = true;
+                rule->name = "st nlpi";
+            } else if (dir == PAL_AUDIO_INPUT &&
+                       type != PAL_STREAM_CONTEXT_PROXY) {
+                rule->tx_conc = true;
+                rule->conc_en = audio_capture_conc_enable || type == PAL_STREAM_PROXY;
+                rule->conc_en_crs = rule->conc_en;
+                rule->name = "audio capture";
+            } else if (type == PAL_STREAM_LOOPBACK) {
+                rule->tx_conc = true;
+                rule->rx_conc = true;
+                rule->conc_en = audio_capture_conc_enable;
+                rule->conc_en_crs = rule->conc_en;
+                rule->name = "loopback";
+            }
+        }
+    }
+
+    PAL_INFO(LOG_TAG, "st concurrency rules compiled, capture %d voice %d voip %d ll bargein %d",
+        audio_capture_conc_enable, voice_conc_enable, voip_conc_enable,
+        low_latency_bargein_enable);
+}
+
 void ResourceManager::GetConcurrencyInfo(Stream* s,
                          bool *rx_conc, bool *tx_conc, bool *conc_en)
 {
     int32_t status  = 0;
-    bool voice_conc_enable = IsVoiceCallConcurrencySupported();
-    bool voip_conc_enable = IsVoipConcurrencySupported();
-    bool low_latency_bargein_enable = IsLowLatencyBargeinSupported();
-    bool audio_capture_conc_enable = IsAudioCaptureConcurrencySupported();
     struct pal_stream_attributes sAttr = {};
+    const struct st_conc_rule *rule = nullptr;
 
     status = s->getStreamAttributes(&sAttr);
     if (status) {
@@ -5581,66 +5746,21 @@ void ResourceManager::GetConcurrencyInfo(Stream* s,
         return;
     }
 
-    if (sAttr.direction == PAL_AUDIO_OUTPUT) {
-        if (sAttr.type == PAL_STREAM_LOW_LATENCY && !low_latency_bargein_enable) {
-            PAL_VERBOSE(LOG_TAG, "Ignore low latency playback stream");
-        } else if (sAttr.type == PAL_STREAM_SENSOR_PCM_RENDERER) {
-            PAL_VERBOSE(LOG_TAG, "Ignore sensor renderer stream");
-        } else if (sAttr.type == PAL_STREAM_HAPTICS) {
-            PAL_VERBOSE(LOG_TAG, "Ignore haptics stream");
-        } else {
-            *rx_conc = true;
-        }
+    if (sAttr.type >= PAL_STREAM_MAX || sAttr.direction > PAL_AUDIO_INPUT_OUTPUT) {
+        PAL_ERR(LOG_TAG, "invalid stream type %d direction %d", sAttr.type, sAttr.direction);
+        return;
     }
 
-    /*
-     * Generally voip/voice rx stream comes with related tx streams,
-     * so there's no need to switch to NLPI for voip/voice rx stream
-     * if corresponding voip/voice tx stream concurrency is not supported.
-     * Also note that capture concurrency has highest proirity that
-     * when capture concurrency is disabled then concurrency for voip
-     * and voice call should also be disabled even voice_conc_enable
-     * or voip_conc_enable is set to true.
-     */
-    if (sAttr.type == PAL_STREAM_VOICE_CALL) {
-        *tx_conc = true;
+    rule = &stConcRules[sAttr.type][sAttr.direction];
+    if (rule->rx_conc)
         *rx_conc = true;
-        if (!audio_capture_conc_enable || !voice_conc_enable) {
-            PAL_DBG(LOG_TAG, "pause on voice concurrency");
-            *conc_en = false;
-        }
-    } else if (sAttr.type == PAL_STREAM_VOIP_TX) {
-        *tx_conc = true;
-        if (!audio_capture_conc_enable || !voip_conc_enable) {
-            PAL_DBG(LOG_TAG, "pause on voip concurrency");
-            *conc_en = false;
-        }
-    } else if (sAttr.type == PAL_STREAM_ACD ||
-               sAttr.type == PAL_STREAM_SENSOR_PCM_DATA ||
-               sAttr.type == PAL_STREAM_VOICE_UI ||
-               sAttr.type == PAL_STREAM_ASR) {
-        if (!s->ConfigSupportLPI()) {
-            *tx_conc = true;
-            PAL_DBG(LOG_TAG, "ST stream type: %d is in NLPI", sAttr.type);
-        }
-    } else if (sAttr.direction == PAL_AUDIO_INPUT &&
-               sAttr.type != PAL_STREAM_CONTEXT_PROXY) {
+    if (rule->tx_conc || (rule->nlpi_tx_conc && !s->ConfigSupportLPI()))
         *tx_conc = true;
-        if (!audio_capture_conc_enable && sAttr.type != PAL_STREAM_PROXY) {
-            PAL_DBG(LOG_TAG, "pause on audio capture concurrency");
-            *conc_en = false;
-        }
-    } else if (sAttr.type == PAL_STREAM_LOOPBACK){
-        *tx_conc = true;
-        *rx_conc = true;
-        if (!audio_capture_conc_enable) {
-            PAL_DBG(LOG_TAG, "pause on LOOPBACK concurrency");
-            *conc_en = false;
-        }
-    }
+    if (!(isCRSCallEnabled ? rule->conc_en_crs : rule->conc_en))
+        *conc_en = false;
 
-    PAL_INFO(LOG_TAG, "stream type %d Tx conc %d, Rx conc %d, concurrency%s allowed",
-        sAttr.type, *tx_conc, *rx_conc, *conc_en? "" : " not");
+    PAL_INFO(LOG_TAG, "stream type %d rule \"%s\": Tx conc %d, Rx conc %d, concurrency%s allowed",
+        sAttr.type, rule->name, *tx_conc, *rx_conc, *conc_en? "" : " not");
 }
 
 void ResourceManager::HandleStreamPauseResume(pal_stream_type_t st_type, bool active)
@@ -5694,7 +5814,13 @@ void ResourceManager::forceSwitchSoundTriggerStreams(bool active) {
     }
 }
 
-/* This function should be called with mActiveStreamMutex lock acquired */
+/*
+ * This function should be called with mActiveStreamMutex lock acquired.
+ * The switch is break-before-make: every detection stream stops on the old
+ * capture profile before any restarts on the new one. A stream owns a single
+ * capture graph and all of them share one VA mic backend config, so graphs
+ * of both profiles cannot be live at the same time.
+ */
 void ResourceManager::handleConcurrentStreamSwitch(std::vector<pal_stream_type_t>& st_streams)
 {
     std::shared_ptr<CaptureProfile> cap_prof_priority = nullptr;
@@ -5753,8 +5879,8 @@ bool ResourceManager::checkAndUpdateDeferSwitchState(bool stream_active)
      *    just reset deferred switch state and switch count, as final
           state would be NLPI, which is current state, hence no change needed.
      * 2. If low latency bargein is enabled, nlpi to lpi switch
-     *    will be deferred by 5s until sleep is done in thread
-     *    voiceUIDeferredSwitchLoop.
+     *    will be deferred by 5s until the reactor timer armed by
+     *    armDeferredSwitch_l fires.
      * 2. If there's any VoiceUI stream in buffering, defer switch
      *    until buffering is done.
      *
@@ -5770,7 +5896,7 @@ bool ResourceManager::checkAndUpdateDeferSwitchState(bool stream_active)
             deferredSwitchState = NO_DEFER;
             PAL_INFO(LOG_TAG, "LPI to NLPI switch cancelled");
             if (IsLowLatencyBargeinSupported())
-                deferred_switch_cnt_ = -1;
+                cancelDeferredSwitch_l();
             return true;
         }
         if (IsLowLatencyBargeinSupported() && active_streams_st.size()) {
@@ -5780,8 +5906,7 @@ bool ResourceManager::checkAndUpdateDeferSwitchState(bool stream_active)
             PAL_INFO(LOG_TAG,
                 "Low latency bargein enabled, defer NLPI->LPI switch, deferred state:%d",
                 deferredSwitchState);
-            deferred_switch_cnt_ = NLPI_LPI_SWITCH_DELAY_SEC;
-            vui_switch_cv_.notify_all();
+            armDeferredSwitch_l();
             return true;
         }
         if (isAnyVUIStreamBuffering()) {
@@ -5795,9 +5920,8 @@ bool ResourceManager::checkAndUpdateDeferSwitchState(bool stream_active)
         if (deferredSwitchState == DEFER_NLPI_LPI_SWITCH) {
             deferredSwitchState = NO_DEFER;
             PAL_INFO(LOG_TAG, "NLPI to LPI switch cancelled");
-            if (IsLowLatencyBargeinSupported()) {
-                deferred_switch_cnt_ = -1;
-            }
+            if (IsLowLatencyBargeinSupported())
+                cancelDeferredSwitch_l();
             return true;
         }
         if (isAnyVUIStreamBuffering()) {
@@ -5813,44 +5937,46 @@ bool ResourceManager::checkAndUpdateDeferSwitchState(bool stream_active)
     return false;
 }
 
-void ResourceManager::voiceUIDeferredSwitchLoop(std::shared_ptr<ResourceManager> rm)
+void ResourceManager::armDeferredSwitch_l()
 {
-    bool is_wake_lock_acquired = false;
-    PAL_INFO(LOG_TAG, "Enter");
-    std::unique_lock<std::mutex> lck(rm->vui_switch_mutex_);
+    uint32_t gen = 0;
 
-    while (!rm->vui_switch_thread_exit_) {
-        if (deferred_switch_cnt_ < 0) {
-            if (is_wake_lock_acquired) {
-                rm->releaseWakeLock();
-                is_wake_lock_acquired = false;
-            }
-            rm->vui_switch_cv_.wait(lck);
-            rm->acquireWakeLock();
-            is_wake_lock_acquired = true;
-        }
+    cancelDeferredSwitch_l();
+    gen = vui_switch_gen_;
 
-        if (rm->vui_switch_thread_exit_)
-            break;
+    // keep the device awake until the deferred switch is done
+    acquireWakeLock();
+    vui_switch_timer_ = PalReactor::getInstance()->postDelayed(
+        NLPI_LPI_SWITCH_DELAY_SEC * 1000,
+        [this, gen]() { onDeferredSwitchTimeout(gen); }, true);
+    if (!vui_switch_timer_) {
+        PAL_ERR(LOG_TAG, "Failed to arm deferred switch timer");
+        releaseWakeLock();
+    }
+}
 
-        if (deferred_switch_cnt_ > 0) {
-            deferred_switch_cnt_--;
-            lck.unlock();
-            sleep(NLPI_LPI_SWITCH_SLEEP_INTERVAL_SEC);
-            lck.lock();
-        }
+void ResourceManager::cancelDeferredSwitch_l()
+{
+    // a callback already dispatched sees a stale generation and bails out
+    vui_switch_gen_++;
+    if (vui_switch_timer_ &&
+        PalReactor::getInstance()->cancel(vui_switch_timer_))
+        releaseWakeLock();
+    vui_switch_timer_ = 0;
+}
 
-        if (deferred_switch_cnt_ == 0) {
-            lck.unlock();
-            rm->handleDeferredSwitch();
-            lck.lock();
-            if (deferred_switch_cnt_ == 0)
-                deferred_switch_cnt_ = -1;
-        }
-    }
+void ResourceManager::onDeferredSwitchTimeout(uint32_t gen)
+{
+    std::unique_lock<std::mutex> lck(vui_switch_mutex_);
 
-    if (is_wake_lock_acquired)
-        rm->releaseWakeLock();
+    if (gen == vui_switch_gen_) {
+        vui_switch_timer_ = 0;
+        lck.unlock();
+        handleDeferredSwitch();
+    } else {
+        lck.unlock();
+    }
+    releaseWakeLock();
 }
 
 void ResourceManager::handleDeferredSwitch()
@@ -7134,6 +7260,7 @@ void ResourceManager::deinit()
     card_status_t state = CARD_STATUS_NONE;
 
     mixerClosed = true;
+    ThermalCalService::getInstance()->invalidateMixer(audio_hw_mixer);
     mixer_close(audio_virt_mixer);
     mixer_close(audio_hw_mixer);
     if (audio_route) {
@@ -7144,13 +7271,15 @@ void ResourceManager::deinit()
     }
     PAL_DBG(LOG_TAG, "Mixer event thread joined");
     if (rm && rm->IsLowLatencyBargeinSupported()) {
+        PalReactor::TimerId timer = 0;
+
         vui_switch_mutex_.lock();
-        vui_switch_thread_exit_ = true;
-        vui_switch_cv_.notify_all();
+        timer = vui_switch_timer_;
+        rm->cancelDeferredSwitch_l();
         vui_switch_mutex_.unlock();
-        if (vui_deferred_switch_thread_.joinable())
-            vui_deferred_switch_thread_.join();
-        PAL_DBG(LOG_TAG, "VoiceUI deferred switch thread joined");
+        if (timer)
+            PalReactor::getInstance()->cancelSync(timer);
+        PAL_DBG(LOG_TAG, "VoiceUI deferred switch cancelled");
     }
     if (sndmon)
         delete sndmon;
@@ -7176,6 +7305,7 @@ void ResourceManager::deinit()
     }
 #endif
     deviceInfo.clear();
+    invalidateDeviceInfoCache();
     listAllBackEndIds.clear();
     sndDeviceNameLUT.clear();
     deviceLinkName.clear();
@@ -9155,6 +9285,8 @@ int ResourceManager::setConfigParams(struct str_parms *parms)
 
     setPalSsrTriggerParam(parms, value, len);
 
+    setAsyncParamUpdateParam(parms, value, len);
+
 exit:
     PAL_DBG(LOG_TAG,"Exit, status %d", ret);
     if(value != NULL)
@@ -9180,6 +9312,24 @@ void ResourceManager::setPalSsrTriggerParam(struct str_parms *parms,
      }
 }
 
+void ResourceManager::setAsyncParamUpdateParam(struct str_parms *parms,
+                                         char *value, int len)
+{
+    int ret = -EINVAL;
+
+    if (!value || !parms)
+        return;
+
+    ret = str_parms_get_str(parms, AUDIO_PARAMETER_KEY_ASYNC_PARAM_UPDATE,
+                            value, len);
+    if (ret >= 0) {
+        isAsyncParamUpdateEnabled = !strncmp(value, "true", sizeof("true"));
+        PAL_INFO(LOG_TAG, "async param update is set to %d", isAsyncParamUpdateEnabled);
+
+        str_parms_del(parms, AUDIO_PARAMETER_KEY_ASYNC_PARAM_UPDATE);
+    }
+}
+
 int ResourceManager::setLpiLoggingParams(struct str_parms *parms,
                                           char *value, int len)
 {
@@ -9215,6 +9365,22 @@ int ResourceManager::setLoggingLevelParams(struct str_parms *parms,
                  pal_log_lvl);
         ret = 0;
     }
+
+    // the value of pal_log_dump is ignored, dumps always go to PAL_BINLOG_DUMP_DIR
+    if (str_parms_get_str(parms, AUDIO_PARAMETER_KEY_LOG_DUMP, value, len) >= 0) {
+        ret = PalBinLog::dump(PAL_BINLOG_DUMP_DIR);
+        ret = ret < 0 ? ret : 0;
+    }
+
+    if (str_parms_get_str(parms, AUDIO_PARAMETER_KEY_THREAD_POLICY_DUMP, value, len) >= 0) {
+        PalThreadPolicy::dump();
+        ret = 0;
+    }
+
+    if (str_parms_get_str(parms, AUDIO_PARAMETER_KEY_ST_BUFFER_POOL_DUMP, value, len) >= 0) {
+        PalRingBufferPool::dump();
+        ret = 0;
+    }
     return ret;
 }
 
@@ -13121,6 +13287,9 @@ void ResourceManager::processPerfLockConfig(const XML_Char **attr)
     perfConfig.perfLockOpts = perfLockConfigs;
     perfConfig.usePerfLock = true;
 
+    if (attr[4] && strcmp(attr[4], "budget_us") == 0)
+        perfConfig.budgetUs = atoi(attr[5]);
+
     PerfLock::setPerfLockOpt(perfConfig);
 }
 
@@ -13723,6 +13892,8 @@ void ResourceManager::process_device_info(struct xml_userdata *data, const XML_C
                 isMainSpeakerRight = true;
         } else if (!strcmp(tag_name, "quick_cal_time")) {
             spQuickCalTime = atoi(data->data_buf);
+        } else if (!strcmp(tag_name, "vi_idle_hold_ms")) {
+            spViIdleHoldMs = atoi(data->data_buf);
         }else if (!strcmp(tag_name, "ras_enabled")) {
             if (atoi(data->data_buf))
                 isRasEnabled = true;
@@ -14080,6 +14251,12 @@ void ResourceManager::startTag(void *userdata, const XML_Char *tag_name,
     } else if (!strcmp(tag_name, "perf_lock")) {
         processPerfLockConfig(attr);
         return;
+    } else if (!strcmp(tag_name, "thread_policy")) {
+        PalThreadPolicy::parse((const char **)attr);
+        return;
+    } else if (!strcmp(tag_name, "adaptive_buffer")) {
+        PalBufferTuner::parse((const char **)attr);
+        return;
     } else if (!strcmp(tag_name, "silence_detection_config")){
         processSilenceDetectionConfig(attr);
         return;
@@ -14294,6 +14471,7 @@ freeParser:
 closeFile:
     fclose(file);
 done:
+    invalidateDeviceInfoCache();
     return ret;
 }
 
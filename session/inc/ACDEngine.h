@@ -37,11 +37,13 @@
 #define ACDENGINE_H
 
 #include <map>
+#include <set>
 
 #include "ContextDetectionEngine.h"
 #include "SoundTriggerUtils.h"
 #include "StreamACD.h"
 #include "detection_cmn_api.h"
+#include "PalReactor.h"
 
 class Session;
 class Stream;
@@ -77,6 +79,13 @@ private:
     int32_t UnloadSoundModel() override;
     int32_t RegDeregSoundModel(uint32_t param_id, uint8_t *payload, size_t payload_size);
     int32_t PopulateSoundModel(std::string model_file_name, uint32_t model_uuid);
+    int32_t GetModelFile(const std::string &model_file_name, uint8_t **data, size_t *size);
+    int32_t DeregisterSoundModel(uint32_t model_id);
+    bool IsModelLoadNeeded();
+    void CancelDeferredUnload();
+    void ScheduleDeferredUnload();
+    void HandleDeferredUnload(uint32_t gen);
+    void ResetLoadedModels();
     int32_t PopulateEventPayload();
     void ParseEventAndNotifyClient();
     void HandleSessionEvent(uint32_t event_id __unused, void *data, uint32_t size);
@@ -116,5 +125,19 @@ private:
     std::unordered_map<uint32_t, std::string> model_load_needed_;
     std::unordered_map<uint32_t, std::string> model_unload_needed_;
     bool     is_confidence_value_updated_;
+
+    /* read-only mappings of model files, kept for the engine lifetime */
+    struct acd_model_file {
+        uint8_t *data;
+        size_t size;
+    };
+    std::map<std::string, struct acd_model_file> model_files_;
+    /* models registered with the current session instance */
+    std::set<uint32_t> model_loaded_;
+    /* models no context needs anymore, deregistered once the grace period ends */
+    std::unordered_map<uint32_t, std::string> model_unload_pending_;
+    /* outstanding unload timers by generation, only the latest one unloads */
+    std::map<uint32_t, PalReactor::TimerId> unload_timers_;
+    uint32_t unload_gen_;
 };
 #endif  // ACDENGINE_H
@@ -34,7 +34,10 @@
 #ifndef ASRENGINE_H
 #define ASRENGINE_H
 
+#include <deque>
 #include <map>
+#include <mutex>
+#include <vector>
 
 #include "ASRPlatformInfo.h"
 #include "StreamASR.h"
@@ -75,32 +78,40 @@ public:
     int32_t setECRef(Stream *s, std::shared_ptr<Device> dev,
                      bool is_enable, bool setECForFirstTime = false);
     int32_t setParameters(Stream *s, asr_param_id_type_t pid, void* paramPayload = nullptr);
-    uint32_t GetNumOutput() { return numOutput; }
-    uint32_t GetOutputToken() { return outputToken; }
-    uint32_t GetPayloadSize() { return payloadSize; }
-    void releaseEngine() { eng = nullptr; }
+    uint32_t GetNumOutput();
+    uint32_t GetOutputToken();
+    uint32_t GetPayloadSize();
+    void releaseEngine();
 private:
     static void EventProcessingThread(ASREngine *engine);
     static void HandleSessionCallBack(uint64_t hdl, uint32_t event_id, void *data,
                                       uint32_t eventSize);
 
     int32_t PopulateEventPayload();
-    void ParseEventAndNotifyStream();
+    void ParseEventAndNotifyStream(std::vector<uint8_t> &eventData);
     void HandleSessionEvent(uint32_t eventId __unused, void *data, uint32_t size);
     bool IsEngineActive();
 
     bool isCrrDevUsingExtEc;
     bool exitThread;
+    // output being fetched by the event thread, guarded by outputMutex
     uint32_t numOutput;
     uint32_t payloadSize;
     uint32_t outputToken;
+    std::mutex outputMutex;
     uint32_t moduleTagIds[ASR_MAX_PARAM_IDS];
     uint32_t paramIds[ASR_MAX_PARAM_IDS];
     int32_t ecRefCount;
     int32_t devDisconnectCount;
 
-    std::queue<void *> eventQ;
-    static std::shared_ptr<ASREngine> eng;
+    std::deque<std::vector<uint8_t>> eventQ;
+    // drained event buffers, reused so events are not allocated per callback
+    std::vector<std::vector<uint8_t>> eventPool;
+    // pal_asr_event handed to the stream, only touched by the event thread
+    std::vector<uint8_t> streamEvent;
+    // one engine and session per StreamASR, events route by callback cookie
+    static std::map<Stream *, std::shared_ptr<ASREngine>> engines;
+    static std::mutex enginesMutex;
     std::shared_ptr<Device> rxEcDev;
     std::recursive_mutex ecRefMutex;
     std::shared_ptr<ASRPlatformInfo> asrInfo;
@@ -186,6 +186,10 @@ protected:
    static std::vector<allKVs> all_streampps;
    static std::vector<allKVs> all_devices;
    static std::vector<allKVs> all_devicepps;
+   // touch haptics wave designer payloads built at init, indexed by effect id
+   static std::mutex hapticsEffectMutex;
+   static std::vector<std::vector<uint8_t>> hapticsPredefinedPayloads;
+   static std::vector<std::vector<uint8_t>> hapticsComposePayloads;
 
 public:
     void payloadUsbAudioConfig(uint8_t** payload, size_t* size,
@@ -296,6 +300,9 @@ public:
     int populateTagKeyVector(Stream *s, std::vector <std::pair<int,int>> &tkv, int tag, uint32_t* gsltag);
     void payloadTimestamp(std::shared_ptr<std::vector<uint8_t>>& module_payload, size_t *size, uint32_t moduleId);
     static int init();
+    static void compileHapticsEffects();
+    static int getCompiledHapticsPayload(pal_param_haptics_cnfg_t *cfg, uint32_t miid,
+                                         uint8_t **payload, size_t *size);
     static void endTag(void *userdata, const XML_Char *tag_name);
     static void startTag(void *userdata, const XML_Char *tag_name, const XML_Char **attr);
     static void handleData(void *userdata, const char *s, int len);
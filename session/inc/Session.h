@@ -125,6 +125,7 @@ protected:
     bool frontEndIdAllocated = false;
     struct pal_param_haptics_cnfg_t *hpCnfg;
     void setInitialVolume();
+    int waitForSessionTime(uint32_t durationUs);
 public:
     bool isMixerEventCbRegd;
     bool isPauseRegistrationDone;
@@ -167,6 +168,9 @@ public:
     virtual int flush() {return 0;};
     virtual void setEventPayload(uint32_t event_id __unused, void *payload __unused, size_t payload_size __unused) {  };
     virtual int getTimestamp(struct pal_session_time *stime __unused) {return 0;};
+    /* Waits until the DSP has rendered durationUs since the call, e.g. for a
+     * ramp to settle. Sessions without a render position just sleep. */
+    virtual int waitForDspProcessed(uint32_t durationUs);
     /*TODO need to implement connect/disconnect in basecase*/
     virtual int setupSessionDevice(Stream* streamHandle, pal_stream_type_t streamType,
         std::shared_ptr<Device> deviceToCconnect) = 0;
@@ -120,6 +120,18 @@ private:
     std::vector <std::pair<int, int>> tkv;
     bool isGaplessFmt = false;
     bool sendNextTrackParams = false;
+    // next track config set ahead of the partial drain
+    std::mutex next_track_mutex_;
+    bool next_mdata_staged_ = false;
+    struct pal_compr_gapless_mdata next_mdata_;
+    std::vector<uint8_t> next_codec_config_;
+    // guards codec, which the offload thread updates for the next track
+    std::mutex codec_mutex_;
+    int applyCodecConfig(pal_param_payload *param_payload,
+                         pal_stream_direction_t stream_direction);
+    int stageNextTrackParam(uint32_t param_id, pal_param_payload *param_payload);
+    int applyNextTrackConfig();
+    void clearNextTrackConfig();
     bool isGaplessFormat(pal_audio_fmt_t fmt);
     bool isCodecConfigNeeded(pal_audio_fmt_t audio_fmt,
                              pal_stream_direction_t stream_direction);
@@ -154,6 +166,7 @@ public:
     int drain(pal_drain_type_t type);
     int flush();
     int getTimestamp(struct pal_session_time *stime) override;
+    int waitForDspProcessed(uint32_t durationUs) override;
     int setupSessionDevice(Stream* streamHandle, pal_stream_type_t streamType,
         std::shared_ptr<Device> deviceToConnect) override;
     int connectSessionDevice(Stream* streamHandle, pal_stream_type_t streamType,
@@ -39,6 +39,7 @@
 #include "Session.h"
 #include "PalAudioRoute.h"
 #include "PalCommon.h"
+#include "PalBufferTuner.h"
 #include <tinyalsa/asoundlib.h>
 #include <thread>
 #include <mutex>
@@ -54,6 +55,9 @@ class SessionAlsaPcm : public Session
 {
 private:
     uint32_t spr_miid = 0;
+    // the graph has no SPR module, DSP waits fall back to sleeping
+    bool sprUnavailable = false;
+    uint32_t hapticsGenMiid = 0;
     PayloadBuilder* builder;
     struct pcm *pcm;
     struct pcm *pcmRx;
@@ -78,6 +82,10 @@ private:
     static int pcmLpmRefCnt;
     int32_t configureInCallRxMFC();
     static bool silenceEventRegistered;
+    PalBufferTuner bufTuner;
+    // period the pcm was last opened with, 0 before the first open
+    size_t tunedPeriodFrames = 0;
+    void applyBufferTuning(Stream *s, pal_stream_type_t type, struct pcm_config *config);
 public:
 
     SessionAlsaPcm(std::shared_ptr<ResourceManager> Rm);
@@ -101,6 +109,7 @@ public:
     int getParameters(Stream *s, int tagId, uint32_t param_id, void **payload) override;
     int setECRef(Stream *s, std::shared_ptr<Device> rx_dev, bool is_enable) override;
     int getTimestamp(struct pal_session_time *stime) override;
+    int waitForDspProcessed(uint32_t durationUs) override;
     int registerCallBack(session_callback cb, uint64_t cookie) override;
     int drain(pal_drain_type_t type) override;
     int flush();
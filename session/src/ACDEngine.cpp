@@ -66,6 +66,10 @@
 #include "ACDEngine.h"
 
 #include <cmath>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <cutils/trace.h>
 #include "Session.h"
 #include "Stream.h"
@@ -73,8 +77,11 @@
 #include "ResourceManager.h"
 #include "kvh2xml.h"
 #include "acd_api.h"
+#include "PalThreadPolicy.h"
 
 #define FILENAME_LEN 128
+/* keeps a model whose contexts flap off and on again registered */
+#define ACD_MODEL_UNLOAD_GRACE_MS 3000
 std::shared_ptr<ACDEngine> ACDEngine::eng_;
 
 ACDEngine::ACDEngine(Stream *s, std::shared_ptr<ACDStreamConfig> sm_cfg) :
@@ -84,6 +91,7 @@ ACDEngine::ACDEngine(Stream *s, std::shared_ptr<ACDStreamConfig> sm_cfg) :
 
     PAL_DBG(LOG_TAG, "Enter");
 
+    unload_gen_ = 0;
     session_->registerCallBack(HandleSessionCallBack, (uint64_t)this);
 
     PAL_DBG(LOG_TAG, "Exit");
@@ -91,8 +99,22 @@ ACDEngine::ACDEngine(Stream *s, std::shared_ptr<ACDStreamConfig> sm_cfg) :
 
 ACDEngine::~ACDEngine()
 {
+    std::map<uint32_t, PalReactor::TimerId> timers;
+
     PAL_INFO(LOG_TAG, "Enter");
 
+    {
+        std::lock_guard<std::mutex> lck(mutex_);
+        timers.swap(unload_timers_);
+    }
+    // includes unloads cancelled while already running
+    for (auto &timer : timers)
+        PalReactor::getInstance()->cancelSync(timer.second);
+
+    for (auto &file : model_files_)
+        munmap(file.second.data, file.second.size);
+    model_files_.clear();
+
     PAL_INFO(LOG_TAG, "Exit");
 }
 
@@ -338,6 +360,7 @@ void ACDEngine::ParseEventAndNotifyClient()
 void ACDEngine::EventProcessingThread(ACDEngine *engine)
 {
     PAL_INFO(LOG_TAG, "Enter. start thread loop");
+    PalThreadPolicy::apply(PalThreadPolicy::ACD_EVENT);
     if (!engine) {
         PAL_ERR(LOG_TAG, "Error:%d Invalid engine", -EINVAL);
         return;
@@ -442,40 +465,66 @@ int32_t ACDEngine::RegDeregSoundModel(uint32_t sess_param_id, uint8_t *payload,
     return status;
 }
 
-int32_t ACDEngine::PopulateSoundModel(std::string model_file_name, uint32_t model_uuid)
+int32_t ACDEngine::GetModelFile(const std::string &model_file_name,
+                                uint8_t **data, size_t *size)
 {
-    FILE *fp;
-    size_t size = 0, bytes_read = 0;
+    int fd = -1;
+    struct stat st;
+    void *addr = MAP_FAILED;
     int32_t status = 0;
-    void *payload = NULL;
     char filename[FILENAME_LEN];
-    struct param_id_detection_engine_register_multi_sound_model_t *sm_data =
-           nullptr;
+    auto iter = model_files_.find(model_file_name);
+
+    if (iter != model_files_.end()) {
+        *data = iter->second.data;
+        *size = iter->second.size;
+        return 0;
+    }
 
     snprintf(filename, FILENAME_LEN, "%s%s", ACD_SM_FILEPATH, model_file_name.c_str());
-    fp = fopen(filename, "rb");
-    if (!fp) {
+    fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         PAL_ERR(LOG_TAG, "Error:%d Unable to open soundmodel file '%s'", -EIO,
             model_file_name.c_str());
         return -EIO;
     }
-    fseek(fp, 0, SEEK_END);
-    size = ftell(fp);
-    rewind(fp);
-    payload = calloc(1, size);
-    if (!payload) {
-        status = -ENOMEM;
-        goto close_fp;
-    }
 
-    bytes_read = fread((char*)payload, 1, size , fp);
-    if (bytes_read != size) {
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
         status = -EIO;
-        PAL_ERR(LOG_TAG, "Error:%d failed to read data from soundmodel file' %s'\n",
-            status, model_file_name.c_str());
-        goto free_payload;
+        PAL_ERR(LOG_TAG, "Error:%d Invalid soundmodel file '%s'", status,
+            model_file_name.c_str());
+        goto close_fd;
     }
 
+    addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        status = -errno;
+        PAL_ERR(LOG_TAG, "Error:%d failed to map soundmodel file '%s'", status,
+            model_file_name.c_str());
+        goto close_fd;
+    }
+
+    model_files_[model_file_name] = {(uint8_t *)addr, (size_t)st.st_size};
+    *data = (uint8_t *)addr;
+    *size = st.st_size;
+
+close_fd:
+    close(fd);
+    return status;
+}
+
+int32_t ACDEngine::PopulateSoundModel(std::string model_file_name, uint32_t model_uuid)
+{
+    size_t size = 0;
+    int32_t status = 0;
+    uint8_t *model = nullptr;
+    struct param_id_detection_engine_register_multi_sound_model_t *sm_data =
+           nullptr;
+
+    status = GetModelFile(model_file_name, &model, &size);
+    if (status)
+        return status;
+
     sm_data = (struct param_id_detection_engine_register_multi_sound_model_t *)
          calloc(1, sizeof(
          struct param_id_detection_engine_register_multi_sound_model_t) +
@@ -484,22 +533,17 @@ int32_t ACDEngine::PopulateSoundModel(std::string model_file_name, uint32_t mode
     if (sm_data == nullptr) {
         status =  -ENOMEM;
         PAL_ERR(LOG_TAG, "Error:%d Failed to allocate memory for sm_data", status);
-        goto free_smdata;
+        return status;
     }
 
     sm_data->model_id = model_uuid;
     sm_data->model_size = size;
-    ar_mem_cpy(sm_data->model, size, payload, size);
+    ar_mem_cpy(sm_data->model, size, model, size);
     size += (sizeof(param_id_detection_engine_register_multi_sound_model_t));
 
     status = RegDeregSoundModel(PAL_PARAM_ID_LOAD_SOUND_MODEL, (uint8_t *)sm_data, size);
 
-free_smdata:
     free(sm_data);
-free_payload:
-    free(payload);
-close_fp:
-    fclose(fp);
     return status;
 }
 
@@ -855,14 +899,41 @@ bool ACDEngine::IsModelBinAvailable(uint32_t model_id)
     return false;
 }
 
-int32_t ACDEngine::UnloadSoundModel()
+int32_t ACDEngine::DeregisterSoundModel(uint32_t model_id)
 {
     int32_t status = 0;
-    uint32_t model_id;
-    std::string model_type;
     struct param_id_detection_engine_deregister_multi_sound_model_t
                                                      deregister_config;
+    std::shared_ptr<ACDSoundModelInfo> modelInfo = sm_cfg_->GetSoundModelInfoByModelId(model_id);
+
+    if (!modelInfo) {
+        PAL_ERR(LOG_TAG, "Error:failed to obtain model Info by model ID %d", model_id);
+        return -EINVAL;
+    }
+
+    PAL_INFO(LOG_TAG, "Unloading model type: %s id: %d",
+             modelInfo->GetModelType().c_str(), model_id);
     memset(&deregister_config, 0, sizeof(struct param_id_detection_engine_deregister_multi_sound_model_t));
+    deregister_config.model_id = modelInfo->GetModelUUID();
+    if (deregister_config.model_id)
+        status = RegDeregSoundModel(PAL_PARAM_ID_UNLOAD_SOUND_MODEL,
+                                    (uint8_t *)&deregister_config,
+                                    sizeof(deregister_config));
+    if (!status)
+        model_loaded_.erase(model_id);
+
+    return status;
+}
+
+/*
+ * Models are not deregistered as soon as their count drops to 0, they are
+ * parked in model_unload_pending_ and dropped by HandleDeferredUnload()
+ * unless a context needs them again within ACD_MODEL_UNLOAD_GRACE_MS.
+ */
+int32_t ACDEngine::UnloadSoundModel()
+{
+    uint32_t model_id;
+    std::string model_type;
 
     for (auto model : model_unload_needed_) {
         model_id = model.first;
@@ -873,28 +944,98 @@ int32_t ACDEngine::UnloadSoundModel()
          * If the same model-id is already present in the model_load_needed_
          */
         if (model_load_needed_.find(model_id) != model_load_needed_.end() ||
-            !IsModelBinAvailable(model_id)) {
+            !IsModelBinAvailable(model_id) ||
+            model_loaded_.find(model_id) == model_loaded_.end()) {
             PAL_INFO(LOG_TAG, "Skipping Unloading of model type: %s\t id:%d",
                     model_type.c_str(), model_id);
             continue;
         }
 
-        PAL_INFO(LOG_TAG, "Unloading model type: %s id: %d", model_type.c_str(), model_id);
+        PAL_INFO(LOG_TAG, "Deferring unload of model type: %s id: %d", model_type.c_str(), model_id);
+        model_unload_pending_[model_id] = model_type;
+    }
 
-        std::shared_ptr<ACDSoundModelInfo> modelInfo = sm_cfg_->GetSoundModelInfoByModelId(model_id);
-        if (!modelInfo) {
-            status = -EINVAL;
-            PAL_ERR(LOG_TAG, "Error:failed to obtain model Info by model ID %d", model_id);
-            return status;
-        }
-        deregister_config.model_id = modelInfo->GetModelUUID();
-        if (deregister_config.model_id)
-            status = RegDeregSoundModel(PAL_PARAM_ID_UNLOAD_SOUND_MODEL,
-                                        (uint8_t *)&deregister_config,
-                                        sizeof(deregister_config));
+    if (!model_unload_pending_.empty())
+        ScheduleDeferredUnload();
+
+    return 0;
+}
+
+void ACDEngine::CancelDeferredUnload()
+{
+    auto it = unload_timers_.find(unload_gen_);
+
+    // a running unload stays tracked until it has returned
+    if (it != unload_timers_.end() && PalReactor::getInstance()->cancel(it->second))
+        unload_timers_.erase(it);
+    unload_gen_++;
+}
+
+void ACDEngine::ScheduleDeferredUnload()
+{
+    PalReactor::TimerId timer = 0;
+    uint32_t gen = 0;
+
+    CancelDeferredUnload();
+    gen = unload_gen_;
+    timer = PalReactor::getInstance()->postDelayed(ACD_MODEL_UNLOAD_GRACE_MS,
+            [this, gen]() { HandleDeferredUnload(gen); }, true);
+    if (!timer) {
+        PAL_ERR(LOG_TAG, "failed to schedule model unload, models stay loaded");
+    } else {
+        unload_timers_[gen] = timer;
     }
+}
 
-    return status;
+void ACDEngine::HandleDeferredUnload(uint32_t gen)
+{
+    bool restore_eng_state = false;
+    int32_t status = 0;
+
+    std::lock_guard<std::mutex> lck(mutex_);
+    unload_timers_.erase(gen);
+    if (gen != unload_gen_)
+        return;
+
+    if (model_unload_pending_.empty() || eng_streams_.empty())
+        return;
+
+    PAL_DBG(LOG_TAG, "Enter, %zu models to unload", model_unload_pending_.size());
+    if (IsEngineActive()) {
+        ProcessStopEngine(eng_streams_[0]);
+        restore_eng_state = true;
+    }
+
+    for (auto model : model_unload_pending_) {
+        status = DeregisterSoundModel(model.first);
+        if (status)
+            PAL_ERR(LOG_TAG, "Error:%d Failed to unload model id %d", status, model.first);
+    }
+    model_unload_pending_.clear();
+
+    if (restore_eng_state)
+        ProcessStartEngine(eng_streams_[0]);
+    PAL_DBG(LOG_TAG, "Exit");
+}
+
+void ACDEngine::ResetLoadedModels()
+{
+    model_loaded_.clear();
+    model_unload_pending_.clear();
+    CancelDeferredUnload();
+}
+
+/* true if a newly needed model is not registered with the session yet */
+bool ACDEngine::IsModelLoadNeeded()
+{
+    for (auto model : model_load_needed_) {
+        if (model_unload_needed_.find(model.first) == model_unload_needed_.end() &&
+            model_loaded_.find(model.first) == model_loaded_.end() &&
+            IsModelBinAvailable(model.first))
+            return true;
+    }
+
+    return false;
 }
 
 int32_t ACDEngine::PopulateEventPayload()
@@ -978,6 +1119,14 @@ int32_t ACDEngine::LoadSoundModel()
             continue;
         }
 
+        /* needed again within the grace period, still registered */
+        model_unload_pending_.erase(model_id);
+        if (model_loaded_.find(model_id) != model_loaded_.end()) {
+            PAL_INFO(LOG_TAG, "Model type %s id: %d already loaded",
+                    model_type.c_str(), model_id);
+            continue;
+        }
+
         PAL_INFO(LOG_TAG, "Loading model type %s id: %d", model_type.c_str(),  model_id);
 
         sm_info = sm_cfg_->GetSoundModelInfoByModelId(model_id);
@@ -989,6 +1138,8 @@ int32_t ACDEngine::LoadSoundModel()
         if (!bin_name.empty()) {
             uuid = sm_info->GetModelUUID();
             status = PopulateSoundModel(bin_name, uuid);
+            if (!status)
+                model_loaded_.insert(model_id);
         }
     }
 
@@ -1003,22 +1154,24 @@ int32_t ACDEngine::HandleMultiStreamLoadUnload(Stream *s)
     PAL_DBG(LOG_TAG, "Enter");
     std::unique_lock<std::mutex> lck(mutex_);
 
+    /* unloads are only deferred here, the session is untouched */
+    UnloadSoundModel();
+    if (!IsModelLoadNeeded() && !is_confidence_value_updated_) {
+        for (auto model : model_load_needed_)
+            model_unload_pending_.erase(model.first);
+        goto exit;
+    }
+
     if (IsEngineActive()) {
         ProcessStopEngine(eng_streams_[0]);
         restore_eng_state = true;
     }
 
-    status = UnloadSoundModel();
-    if (0 != status) {
-        PAL_ERR(LOG_TAG, "Error:%d Failed to unload sound model", status);
-        session_->close(s);
-        goto exit;
-    }
-
     status = PopulateEventPayload();
     if (0 != status) {
         PAL_ERR(LOG_TAG, "Error:%d Failed to setup Event payload", status);
         session_->close(s);
+        ResetLoadedModels();
         goto exit;
     }
 
@@ -1026,6 +1179,7 @@ int32_t ACDEngine::HandleMultiStreamLoadUnload(Stream *s)
     if (0 != status) {
         PAL_ERR(LOG_TAG, "Error:%d Failed to load sound model", status);
         session_->close(s);
+        ResetLoadedModels();
         goto exit;
     }
     eng_state_ = ENG_LOADED;
@@ -1062,7 +1216,8 @@ int32_t ACDEngine::SetupEngine(Stream *st, void *config)
 
     /* Check whether any stream is already attached to this engine */
     if (AreOtherStreamsAttached(s)) {
-        if (model_load_needed_.size() || is_confidence_value_updated_) {
+        if (model_load_needed_.size() || model_unload_needed_.size() ||
+            is_confidence_value_updated_) {
             lck.unlock();
             status = HandleMultiStreamLoadUnload(s);
             lck.lock();
@@ -1088,6 +1243,7 @@ int32_t ACDEngine::SetupEngine(Stream *st, void *config)
     if (0 != status) {
         PAL_ERR(LOG_TAG, "Error:%d Failed to load sound model", status);
         session_->close(s);
+        ResetLoadedModels();
         goto exit;
     }
     exit_thread_ = false;
@@ -1097,6 +1253,7 @@ int32_t ACDEngine::SetupEngine(Stream *st, void *config)
         PAL_ERR(LOG_TAG, "Error:%d failed to create event processing thread",
                 status);
         session_->close(s);
+        ResetLoadedModels();
         status = -EINVAL;
         goto exit;
     }
@@ -1148,7 +1305,8 @@ int32_t ACDEngine::TeardownEngine(Stream *st, void *config)
 
     /* Check whether any stream is already attached to this engine */
     if (AreOtherStreamsAttached(s)) {
-        if (model_unload_needed_.size() || is_confidence_value_updated_) {
+        if (model_unload_needed_.size() || model_load_needed_.size() ||
+            is_confidence_value_updated_) {
             lck.unlock();
             status = HandleMultiStreamLoadUnload(s);
             lck.lock();
@@ -1170,6 +1328,7 @@ int32_t ACDEngine::TeardownEngine(Stream *st, void *config)
     status = session_->close(s);
     if (status)
         PAL_ERR(LOG_TAG, "Error:%d Failed to close session", status);
+    ResetLoadedModels();
 
     eng_state_ = ENG_IDLE;
 exit:
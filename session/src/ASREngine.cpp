@@ -44,6 +44,7 @@
 #include "StreamASR.h"
 #include "ResourceManager.h"
 #include "kvh2xml.h"
+#include "PalThreadPolicy.h"
 
 #define ASR_DBG_LOGS
 #ifdef ASR_DBG_LOGS
@@ -51,7 +52,8 @@
 #endif
 
 #define FILENAME_LEN 128
-std::shared_ptr<ASREngine> ASREngine::eng;
+std::map<Stream *, std::shared_ptr<ASREngine>> ASREngine::engines;
+std::mutex ASREngine::enginesMutex;
 
 ASREngine::ASREngine(Stream *s, std::shared_ptr<ASRStreamConfig> smCfg)
     : smCfg(smCfg)
@@ -60,13 +62,14 @@ ASREngine::ASREngine(Stream *s, std::shared_ptr<ASRStreamConfig> smCfg)
     int status = 0;
     struct pal_stream_attributes sAttr;
     std::shared_ptr<ResourceManager> rm = nullptr;
-    static std::shared_ptr<ASREngine> eng = nullptr;
 
     isCrrDevUsingExtEc = false;
     exitThread = false;
     ecRefCount = 0;
     devDisconnectCount = 0;
     numOutput = 0;
+    outputToken = 0;
+    payloadSize = 0;
     rxEcDev = nullptr;
     asrInfo = nullptr;
     engState = ASR_ENG_IDLE;
@@ -117,21 +120,22 @@ ASREngine::~ASREngine()
 {
     PAL_INFO(LOG_TAG, "Enter");
 
-    smCfg = nullptr;
-    asrInfo = nullptr;
-    session = nullptr;
-    streamHandle = nullptr;
-
     {
         std::unique_lock<std::mutex> lck(mutexEngine);
         exitThread = true;
         cv.notify_one();
     }
 
+    // the event thread uses session and streamHandle without mutexEngine
     if(eventThreadHandler.joinable()) {
         eventThreadHandler.join();
     }
 
+    smCfg = nullptr;
+    asrInfo = nullptr;
+    session = nullptr;
+    streamHandle = nullptr;
+
     PAL_INFO(LOG_TAG, "Exit");
 }
 
@@ -139,12 +143,22 @@ std::shared_ptr<ASREngine> ASREngine::GetInstance(
      Stream *s,
      std::shared_ptr<ASRStreamConfig> smCfg)
 {
+     std::lock_guard<std::mutex> lck(enginesMutex);
+     std::shared_ptr<ASREngine> &eng = engines[s];
+
      if (!eng)
          eng = std::make_shared<ASREngine>(s, smCfg);
 
      return eng;
 }
 
+void ASREngine::releaseEngine()
+{
+    std::lock_guard<std::mutex> lck(enginesMutex);
+
+    engines.erase(streamHandle);
+}
+
 bool ASREngine::IsEngineActive()
 {
     if (engState == ASR_ENG_ACTIVE ||
@@ -344,25 +358,26 @@ exit:
     return status;
 }
 
-void ASREngine::ParseEventAndNotifyStream() {
+void ASREngine::ParseEventAndNotifyStream(std::vector<uint8_t> &eventData) {
 
     PAL_DBG(LOG_TAG, "Enter.");
 
     int32_t status = 0;
     bool eventStatus = false;
     void *payload = nullptr;
-    uint8_t *temp;
     size_t eventSize = 0;
-    event_id_asr_output_event_t *event;
-    asr_output_status_t *ev;
-    pal_asr_event *eventToStream;
-    StreamASR *sAsr;
-
-    event = (struct event_id_asr_output_event_t *)eventQ.front();
-    if (event == nullptr) {
+    size_t outputSize = 0;
+    uint32_t textSize = 0;
+    event_id_asr_output_event_t *event = nullptr;
+    asr_output_status_t *ev = nullptr;
+    pal_asr_event *eventToStream = nullptr;
+    StreamASR *sAsr = nullptr;
+
+    if (eventData.size() < sizeof(struct event_id_asr_output_event_t)) {
         PAL_ERR(LOG_TAG, "Invalid event!!!");
         goto exit;
     }
+    event = (struct event_id_asr_output_event_t *)eventData.data();
 
     PAL_INFO(LOG_TAG, "Output mode : %d, output token : %d, num output : %d, payload size : %d",
             event->asr_out_mode, event->output_token, event->num_outputs, event->payload_size);
@@ -372,28 +387,43 @@ void ASREngine::ParseEventAndNotifyStream() {
         goto exit;
     }
 
-    eventSize = sizeof(pal_asr_event) + event->num_outputs * sizeof(pal_asr_engine_event);
-    eventToStream = (pal_asr_event *)calloc(1, eventSize);
-    if (eventToStream == nullptr) {
-        PAL_ERR(LOG_TAG, "Failed to allocate memory for stream event!!");
-        goto exit;
+    // the session sizes and fills the ASR_OUTPUT query from these
+    {
+        std::lock_guard<std::mutex> lck(outputMutex);
+        numOutput = event->num_outputs;
+        outputToken = event->output_token;
+        payloadSize = event->payload_size;
+    }
+
+    /*
+     * payload_size announces the transcripts following the event header,
+     * query the module only when the event carries the notification alone.
+     */
+    outputSize = event->num_outputs * sizeof(asr_output_status_t);
+    if (event->payload_size >= outputSize &&
+        eventData.size() - sizeof(struct event_id_asr_output_event_t) >=
+            event->payload_size) {
+        ev = (asr_output_status_t *)(eventData.data() +
+                                     sizeof(struct event_id_asr_output_event_t));
+    } else {
+        status = session->getParameters(streamHandle,
+                               moduleTagIds[ASR_OUTPUT], PAL_PARAM_ID_ASR_OUTPUT,
+                               &payload);
+        if (status != 0 || !payload) {
+            PAL_ERR(LOG_TAG, "Failed to get output payload");
+            goto cleanup;
+        }
+        ev = (asr_output_status_t *)((uint8_t *)payload +
+                                     sizeof(struct param_id_asr_output_t));
     }
 
-    eventToStream->num_events = event->num_outputs;
-    numOutput = event->num_outputs;
-    outputToken = event->output_token;
-    payloadSize = event->payload_size;
-
-    status = session->getParameters(streamHandle,
-                           moduleTagIds[ASR_OUTPUT], PAL_PARAM_ID_ASR_OUTPUT,
-                           &payload);
-    if (status != 0) {
-        PAL_ERR(LOG_TAG, "Failed to get output payload");
-        goto cleanup;
-    }
+    eventSize = sizeof(pal_asr_event) + event->num_outputs * sizeof(pal_asr_engine_event);
+    if (streamEvent.size() < eventSize)
+        streamEvent.resize(eventSize);
+    memset(streamEvent.data(), 0, eventSize);
+    eventToStream = (pal_asr_event *)streamEvent.data();
 
-    temp = (uint8_t *)payload;
-    ev = (asr_output_status_t *)(temp + sizeof(struct param_id_asr_output_t));
+    eventToStream->num_events = event->num_outputs;
 
     for (int i = 0; i < event->num_outputs; i++) {
         eventStatus = (ev[i].status == 0 ? true : false);
@@ -401,11 +431,13 @@ void ASREngine::ParseEventAndNotifyStream() {
             PAL_INFO(LOG_TAG, "Recieved failure event, ignoring this event!!!");
             goto cleanup;
         }
+        textSize = ev[i].text_size < 0 ? 0 : ev[i].text_size;
+        if (textSize >= MAX_TRANSCRIPTION_CHAR_SIZE)
+            textSize = MAX_TRANSCRIPTION_CHAR_SIZE - 1;
         eventToStream->event[i].is_final = ev[i].is_final;
         eventToStream->event[i].confidence = ev[i].confidence;
-        eventToStream->event[i].text_size = ev[i].text_size < 0 ? 0 : ev[i].text_size;
-        for (int j = 0; j < ev[i].text_size; ++j)
-            eventToStream->event[i].text[j] = ev[i].text[j];
+        eventToStream->event[i].text_size = textSize;
+        memcpy(eventToStream->event[i].text, ev[i].text, textSize);
     }
 
 
@@ -413,46 +445,72 @@ void ASREngine::ParseEventAndNotifyStream() {
 
     sAsr = dynamic_cast<StreamASR *>(streamHandle);
     sAsr->HandleEventData(eventToStream, eventSize);
-    numOutput = 0;
-    outputToken = 0;
-    payloadSize = 0;
 
 cleanup:
-    if (eventToStream)
-        free(eventToStream);
-
+    {
+        std::lock_guard<std::mutex> lck(outputMutex);
+        numOutput = 0;
+        outputToken = 0;
+        payloadSize = 0;
+    }
     if (payload)
         free(payload);
 
-    if (event)
-        free(event);
-
 exit:
-    eventQ.pop();
+    return;
+}
+
+uint32_t ASREngine::GetNumOutput()
+{
+    std::lock_guard<std::mutex> lck(outputMutex);
+
+    return numOutput;
+}
+
+uint32_t ASREngine::GetOutputToken()
+{
+    std::lock_guard<std::mutex> lck(outputMutex);
+
+    return outputToken;
+}
+
+uint32_t ASREngine::GetPayloadSize()
+{
+    std::lock_guard<std::mutex> lck(outputMutex);
+
+    return payloadSize;
 }
 
 void ASREngine::EventProcessingThread(ASREngine *engine)
 {
+    std::vector<uint8_t> event;
+
     PAL_INFO(LOG_TAG, "Enter. start thread loop");
+    PalThreadPolicy::apply(PalThreadPolicy::ASR_EVENT);
     if (!engine) {
         PAL_ERR(LOG_TAG, "Error:%d Invalid engine", -EINVAL);
         return;
     }
     std::unique_lock<std::mutex> lck(engine->mutexEngine);
     while (!engine->exitThread) {
-        while (engine->eventQ.empty()) {
+        if (engine->eventQ.empty()) {
             PAL_DBG(LOG_TAG, "waiting on cond");
             engine->cv.wait(lck);
             PAL_DBG(LOG_TAG, "done waiting on cond");
-
-            if (engine->exitThread) {
-                PAL_VERBOSE(LOG_TAG, "Exit thread");
-                break;
-            }
+            //destructor can also notify this thread without any event
+            continue;
         }
-        //Adding this condition, as destructor can also notify this thread without any event
-        if (!engine->eventQ.empty())
-            engine->ParseEventAndNotifyStream();
+
+        event = std::move(engine->eventQ.front());
+        engine->eventQ.pop_front();
+
+        // partial results keep queueing while the client handles this one
+        lck.unlock();
+        engine->ParseEventAndNotifyStream(event);
+        lck.lock();
+
+        engine->eventPool.push_back(std::move(event));
+        event = std::vector<uint8_t>();
     }
 
     PAL_DBG(LOG_TAG, "Exit");
@@ -461,7 +519,7 @@ void ASREngine::EventProcessingThread(ASREngine *engine)
 void ASREngine::HandleSessionEvent(uint32_t event_id __unused,
                                    void *data, uint32_t size)
 {
-    void *eventData = nullptr;
+    std::vector<uint8_t> eventData;
 
     std::unique_lock<std::mutex> lck(mutexEngine);
 
@@ -471,14 +529,12 @@ void ASREngine::HandleSessionEvent(uint32_t event_id __unused,
         return;
     }
 
-    eventData = calloc(1, size);
-    if (!eventData) {
-        PAL_ERR(LOG_TAG, "Error:failed to allocate mem for event_data");
-        return;
+    if (!eventPool.empty()) {
+        eventData = std::move(eventPool.back());
+        eventPool.pop_back();
     }
-
-    memcpy(eventData, data, size);
-    eventQ.push(eventData);
+    eventData.assign((uint8_t *)data, (uint8_t *)data + size);
+    eventQ.push_back(std::move(eventData));
     cv.notify_one();
 }
 
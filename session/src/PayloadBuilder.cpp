@@ -265,6 +265,11 @@ std::vector<allKVs> PayloadBuilder::all_streams;
 std::vector<allKVs> PayloadBuilder::all_streampps;
 std::vector<allKVs> PayloadBuilder::all_devices;
 std::vector<allKVs> PayloadBuilder::all_devicepps;
+std::mutex PayloadBuilder::hapticsEffectMutex;
+std::vector<std::vector<uint8_t>> PayloadBuilder::hapticsPredefinedPayloads;
+std::vector<std::vector<uint8_t>> PayloadBuilder::hapticsComposePayloads;
+
+#define HAPTICS_NUM_STRENGTHS 3
 
 template <typename T>
 void PayloadBuilder::populateChannelMixerCoeff(T pcmChannel, uint8_t numChannel,
@@ -4917,6 +4922,129 @@ void PayloadBuilder::payloadHapticsDevPConfig(uint8_t** payload, size_t* size, u
     *payload = payloadInfo;
 }
 
+void PayloadBuilder::compileHapticsEffects()
+{
+    std::shared_ptr<AudioHapticsInterface> hap_info = AudioHapticsInterface::GetInstance();
+    PayloadBuilder builder;
+    pal_param_haptics_cnfg_t cfg;
+    uint8_t *payload = nullptr;
+    size_t size = 0;
+    int count = 0;
+
+    if (!hap_info)
+        return;
+
+    std::lock_guard<std::mutex> lck(hapticsEffectMutex);
+    hapticsPredefinedPayloads.clear();
+    hapticsComposePayloads.clear();
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.mode = PAL_STREAM_HAPTICS_TOUCH;
+    cfg.ch_mask = 1;
+
+    /*
+     * Predefined effects get one payload per strength level, compose effects
+     * get a single one; channel mask, miid and for compose the intensity
+     * derived from amplitude are patched in when the effect is triggered.
+     */
+    count = hap_info->getTouchHapticsEffectCount(false);
+    hapticsPredefinedPayloads.resize(count * HAPTICS_NUM_STRENGTHS);
+    for (int id = 0; id < count; id++) {
+        for (int strength = 0; strength < HAPTICS_NUM_STRENGTHS; strength++) {
+            cfg.effect_id = id;
+            cfg.isCompose = false;
+            cfg.strength = strength;
+            size = 0;
+            builder.payloadHapticsDevPConfig(&payload, &size, 0,
+                                 PARAM_ID_HAPTICS_WAVE_DESIGNER_CFG, (void *)&cfg);
+            if (payload && size)
+                hapticsPredefinedPayloads[id * HAPTICS_NUM_STRENGTHS + strength].assign(
+                                 payload, payload + size);
+            free(payload);
+            payload = nullptr;
+        }
+    }
+
+    count = hap_info->getTouchHapticsEffectCount(true);
+    hapticsComposePayloads.resize(count);
+    for (int id = 0; id < count; id++) {
+        cfg.effect_id = id;
+        cfg.isCompose = true;
+        cfg.strength = 0;
+        size = 0;
+        builder.payloadHapticsDevPConfig(&payload, &size, 0,
+                             PARAM_ID_HAPTICS_WAVE_DESIGNER_CFG, (void *)&cfg);
+        if (payload && size)
+            hapticsComposePayloads[id].assign(payload, payload + size);
+        free(payload);
+        payload = nullptr;
+    }
+
+    PAL_INFO(LOG_TAG, "compiled %zu predefined and %zu compose haptics payloads",
+             hapticsPredefinedPayloads.size(), hapticsComposePayloads.size());
+}
+
+int PayloadBuilder::getCompiledHapticsPayload(pal_param_haptics_cnfg_t *cfg, uint32_t miid,
+                                              uint8_t **payload, size_t *size)
+{
+    struct apm_module_param_data_t *header = nullptr;
+    param_id_haptics_wave_designer_config_t *hpconf = nullptr;
+    rx_wave_designer_config_h *hpwaveConf = nullptr;
+    const std::vector<uint8_t> *compiled = nullptr;
+    uint8_t *payloadInfo = nullptr;
+    uint32_t idx = 0;
+
+    if (!cfg || !payload || !size)
+        return -EINVAL;
+
+    // one shot effects carry a client supplied duration, not precompiled
+    if (cfg->mode != PAL_STREAM_HAPTICS_TOUCH || cfg->effect_id < 0)
+        return -ENOENT;
+
+    std::lock_guard<std::mutex> lck(hapticsEffectMutex);
+    if (cfg->isCompose) {
+        if ((size_t)cfg->effect_id < hapticsComposePayloads.size())
+            compiled = &hapticsComposePayloads[cfg->effect_id];
+    } else {
+        idx = cfg->effect_id * HAPTICS_NUM_STRENGTHS;
+        if (cfg->strength == 1 || cfg->strength == 2)
+            idx += cfg->strength;
+        if (idx < hapticsPredefinedPayloads.size())
+            compiled = &hapticsPredefinedPayloads[idx];
+    }
+    if (!compiled || compiled->empty())
+        return -ENOENT;
+
+    payloadInfo = (uint8_t *)malloc(compiled->size());
+    if (!payloadInfo) {
+        PAL_ERR(LOG_TAG, "payloadInfo malloc failed %s", strerror(errno));
+        return -ENOMEM;
+    }
+    memcpy(payloadInfo, compiled->data(), compiled->size());
+
+    header = (struct apm_module_param_data_t *)payloadInfo;
+    hpconf = (param_id_haptics_wave_designer_config_t *)(payloadInfo +
+                 sizeof(struct apm_module_param_data_t));
+    hpwaveConf = (rx_wave_designer_config_h *)(payloadInfo +
+                 sizeof(struct apm_module_param_data_t) +
+                 sizeof(param_id_haptics_wave_designer_config_t));
+    header->module_instance_id = miid;
+    hpconf->channel_mask = cfg->ch_mask;
+    if (cfg->isCompose) {
+        for (int ch = 0; ch < hpconf->num_channels; ch++) {
+            hpwaveConf[ch].pulse_intensity = (cfg->amplitude * 100);
+            if (hpwaveConf[ch].pulse_intensity > 100 ||
+                                hpwaveConf[ch].pulse_intensity <= 0)
+                hpwaveConf[ch].pulse_intensity = 30;
+        }
+    }
+
+    *payload = payloadInfo;
+    *size = compiled->size();
+
+    return 0;
+}
+
 #define NUM_OF_IN_PORTS  1
 #define NUM_OF_OUT_PORTS 3
 void PayloadBuilder::payloadDAMPortConfig(uint8_t** payload, size_t* size,
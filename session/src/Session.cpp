@@ -81,6 +81,8 @@
 #include <sys/stat.h>
 #include <sys/klog.h>        /* Definition of SYSLOG_* constants */
 #include <time.h>
+#include <unistd.h>
+#include <chrono>
 
 #ifndef DUMP_OUT_PATH
 #define DUMP_OUT_PATH "/data/vendor/audio/"
@@ -92,6 +94,9 @@
 #define SYSLOG_ACTION_SIZE_BUFFER 10
 #define TIMESTAMP_FORMAT_STRING "_%Y_%m_%d_%H_%M_%S"
 
+#define DSP_WAIT_POLL_US    (5*1000)
+#define DSP_WAIT_MARGIN_US  (10*1000)
+
 #define BOLERO_PROC_INTF    "/proc/lpass_cdc_reginfo/lpass_cdc_regdump"
 #define WCD939X_PROC_INTF   "/proc/wcd939x_reginfo/wcd939x_regdump"
 #define WSA884X_1_PROC_INTF "/proc/wsa884x_reginfo_1/wsa884x_regdump"
@@ -99,6 +104,7 @@
 #define WSA883X_1_PROC_INTF "/proc/wsa883x_reginfo_1/wsa883x_regdump"
 #define WSA883X_2_PROC_INTF "/proc/wsa883x_reginfo_2/wsa883x_regdump"
 #define WSA_SWR_PROC_INTF  "/proc/wsa_swr_ctrl/swr_mstr_ctrl_regdump"
+
 #define WSA2_SWR_PROC_INTF "/proc/wsa2_swr_ctrl/swr_mstr_ctrl_regdump"
 #define VA_SWR_PROC_INTF   "/proc/va_swr_ctrl/swr_mstr_ctrl_regdump"
 #define RX_SWR_PROC_INTF   "/proc/rx_swr_ctrl/swr_mstr_ctrl_regdump"
@@ -136,6 +142,68 @@ Session::~Session()
 
 }
 
+int Session::waitForDspProcessed(uint32_t durationUs)
+{
+    usleep(durationUs);
+    return 0;
+}
+
+static uint64_t sessionTimeUs(const struct pal_session_time *stime)
+{
+    return ((uint64_t)stime->session_time.value_msw << 32) |
+            stime->session_time.value_lsw;
+}
+
+/*
+ * Polls the render position until the graph has rendered durationUs, for
+ * at most DSP_WAIT_MARGIN_US past durationUs. A graph that is not
+ * rendering is waited on for durationUs, as a plain sleep would.
+ */
+int Session::waitForSessionTime(uint32_t durationUs)
+{
+    struct pal_session_time stime = {};
+    uint64_t startUs = 0, lastUs = 0, curUs = 0;
+    std::chrono::steady_clock::time_point now, fullWait, deadline;
+
+    if (getTimestamp(&stime)) {
+        usleep(durationUs);
+        return 0;
+    }
+
+    startUs = lastUs = sessionTimeUs(&stime);
+    now = std::chrono::steady_clock::now();
+    fullWait = now + std::chrono::microseconds(durationUs);
+    deadline = fullWait + std::chrono::microseconds(DSP_WAIT_MARGIN_US);
+    while (true) {
+        usleep(DSP_WAIT_POLL_US);
+        now = std::chrono::steady_clock::now();
+        if (getTimestamp(&stime)) {
+            if (now < fullWait)
+                usleep(std::chrono::duration_cast<std::chrono::microseconds>(
+                        fullWait - now).count());
+            return 0;
+        }
+
+        curUs = sessionTimeUs(&stime);
+        if (curUs - startUs >= durationUs)
+            return 0;
+
+        // no progress since the last poll and the full duration has passed
+        if (curUs == lastUs && now >= fullWait) {
+            PAL_DBG(LOG_TAG, "graph not rendering, skip margin");
+            return 0;
+        }
+        lastUs = curUs;
+
+        if (now >= deadline)
+            break;
+    }
+
+    PAL_DBG(LOG_TAG, "rendered %llu of %u us before timeout",
+            (unsigned long long)(lastUs - startUs), durationUs);
+    return -ETIMEDOUT;
+}
+
 void Session::setPmQosMixerCtl(pmQosVote vote)
 {
     int status = 0;
@@ -40,6 +40,7 @@
 #include "ResourceManager.h"
 #include "media_fmt_api.h"
 #include "gapless_api.h"
+#include "PalThreadPolicy.h"
 #include <agm/agm_api.h>
 #include <sstream>
 #include <mutex>
@@ -698,6 +699,8 @@ void SessionAlsaCompress::offloadThreadLoop(SessionAlsaCompress* compressObj)
     uint32_t event_id = 0;
     int ret = 0;
     bool is_drain_called = false;
+
+    PalThreadPolicy::apply(PalThreadPolicy::OFFLOAD);
     std::unique_lock<std::mutex> lock(compressObj->cv_mutex_);
 
     while (1) {
@@ -752,6 +755,7 @@ void SessionAlsaCompress::offloadThreadLoop(SessionAlsaCompress* compressObj)
                         ret = compress_next_track(compressObj->compress);
                         PAL_INFO(LOG_TAG, "out of compress next track, ret %d", ret);
                         if (ret == 0) {
+                            compressObj->applyNextTrackConfig();
                             ret = compress_partial_drain(compressObj->compress);
                             PAL_INFO(LOG_TAG, "out of partial compress_drain, ret %d", ret);
                         }
@@ -1421,7 +1425,10 @@ int SessionAlsaCompress::start(Stream * s)
     memset(&dAttr, 0, sizeof(struct pal_device));
     rm->voteSleepMonitor(s, true);
     s->getStreamAttributes(&sAttr);
-    getSndCodecParam(codec, sAttr);
+    {
+        std::lock_guard<std::mutex> lck(codec_mutex_);
+        getSndCodecParam(codec, sAttr);
+    }
     s->getBufInfo(&in_buf_size, &in_buf_count, &out_buf_size,
                           &out_buf_count);
 
@@ -1820,6 +1827,7 @@ int SessionAlsaCompress::stop(Stream * s __unused)
                 status = compress_stop(compress);
                 playback_started = false;
             }
+            clearNextTrackConfig();
             // Deregister for callback for Soft Pause
             if (isPauseRegistrationDone) {
                 payload_size = sizeof(struct agm_event_reg_cfg);
@@ -2239,24 +2247,16 @@ int SessionAlsaCompress::setParameters(Stream *s __unused, int tagId, uint32_t p
         }
         case PAL_PARAM_ID_CODEC_CONFIGURATION:
             PAL_DBG(LOG_TAG, "Compress Codec Configuration");
-            updateCodecOptions((pal_param_payload *)payload, sAttr.direction);
-            if (compress && audio_fmt != PAL_AUDIO_FMT_VORBIS) {
-                /* For some audio fmt, codec configuration is default like
-                 * for mp3, and for some it is hardcoded like for aac, in
-                 * these cases, we don't need to send codec params to ADSP
-                 * again even if it comes from hal as it will not change.
-                 */
-                if (isCodecConfigNeeded(audio_fmt, sAttr.direction)) {
-                    PAL_DBG(LOG_TAG, "Setting params for second clip for gapless");
-                    status = compress_set_codec_params(compress, &codec);
-                } else {
-                    PAL_INFO(LOG_TAG, "No need to send params for second clip fmt %x", audio_fmt);
-                }
-            } else if (compress && (audio_fmt == PAL_AUDIO_FMT_VORBIS)) {
-                PAL_DBG(LOG_TAG, "Setting params for second clip for gapless");
-                sendNextTrackParams = true;
-                status = setCustomFormatParam(audio_fmt);
+            status = applyCodecConfig((pal_param_payload *)payload, sAttr.direction);
+        break;
+        case PAL_PARAM_ID_GAPLESS_NEXT_MDATA:
+        case PAL_PARAM_ID_NEXT_CODEC_CONFIGURATION:
+            if (!isGaplessFmt || sAttr.direction != PAL_AUDIO_OUTPUT) {
+                PAL_ERR(LOG_TAG, "audio fmt %x is not gapless", audio_fmt);
+                status = -EINVAL;
+                goto exit;
             }
+            status = stageNextTrackParam(param_id, param_payload);
         break;
         case PAL_PARAM_ID_GAPLESS_MDATA:
         {
@@ -2471,6 +2471,8 @@ int SessionAlsaCompress::flush()
     int status = 0;
     PAL_VERBOSE(LOG_TAG, "Enter flush");
 
+    clearNextTrackConfig();
+
     if (playback_started) {
         if (compressDevIds.size() > 0) {
             status = SessionAlsaUtils::flush(rm, compressDevIds.at(0));
@@ -2484,6 +2486,118 @@ int SessionAlsaCompress::flush()
     return status;
 }
 
+/*
+ * Updates codec from a PAL_PARAM_ID_CODEC_CONFIGURATION payload and sends
+ * it to the DSP. Both the client setParameters and the offload thread,
+ * which applies a staged next track config without the stream lock,
+ * come here, so codec is only touched with codec_mutex_ held.
+ */
+int SessionAlsaCompress::applyCodecConfig(pal_param_payload *param_payload,
+                                          pal_stream_direction_t stream_direction)
+{
+    std::lock_guard<std::mutex> lck(codec_mutex_);
+    int status = 0;
+
+    updateCodecOptions(param_payload, stream_direction);
+    if (compress && audio_fmt != PAL_AUDIO_FMT_VORBIS) {
+        /* For some audio fmt, codec configuration is default like
+         * for mp3, and for some it is hardcoded like for aac, in
+         * these cases, we don't need to send codec params to ADSP
+         * again even if it comes from hal as it will not change.
+         */
+        if (isCodecConfigNeeded(audio_fmt, stream_direction)) {
+            PAL_DBG(LOG_TAG, "Setting params for second clip for gapless");
+            status = compress_set_codec_params(compress, &codec);
+        } else {
+            PAL_INFO(LOG_TAG, "No need to send params for second clip fmt %x", audio_fmt);
+        }
+    } else if (compress && (audio_fmt == PAL_AUDIO_FMT_VORBIS)) {
+        PAL_DBG(LOG_TAG, "Setting params for second clip for gapless");
+        sendNextTrackParams = true;
+        status = setCustomFormatParam(audio_fmt);
+    }
+
+    return status;
+}
+
+int SessionAlsaCompress::stageNextTrackParam(uint32_t param_id,
+                                             pal_param_payload *param_payload)
+{
+    std::lock_guard<std::mutex> lck(next_track_mutex_);
+
+    if (!param_payload) {
+        PAL_ERR(LOG_TAG, "invalid payload for param %u", param_id);
+        return -EINVAL;
+    }
+
+    if (param_id == PAL_PARAM_ID_GAPLESS_NEXT_MDATA) {
+        if (param_payload->payload_size < sizeof(struct pal_compr_gapless_mdata)) {
+            PAL_ERR(LOG_TAG, "invalid gapless metadata size %u",
+                    param_payload->payload_size);
+            return -EINVAL;
+        }
+        memcpy(&next_mdata_, param_payload->payload, sizeof(next_mdata_));
+        next_mdata_staged_ = true;
+        PAL_DBG(LOG_TAG, "staged next track metadata %d %d",
+                next_mdata_.encoderDelay, next_mdata_.encoderPadding);
+    } else {
+        next_codec_config_.assign((uint8_t *)param_payload,
+                (uint8_t *)param_payload + sizeof(pal_param_payload) +
+                param_payload->payload_size);
+        PAL_DBG(LOG_TAG, "staged next track codec config");
+    }
+
+    return 0;
+}
+
+/*
+ * Called by the offload thread right after compress_next_track, so the
+ * next track is configured before its first buffer is written and the
+ * partial drain does not wait for another client round trip.
+ */
+int SessionAlsaCompress::applyNextTrackConfig()
+{
+    std::vector<uint8_t> codecConfig;
+    struct pal_compr_gapless_mdata gaplessMdata = {};
+    struct compr_gapless_mdata mdata;
+    bool mdataStaged = false;
+    int status = 0;
+
+    {
+        std::lock_guard<std::mutex> lck(next_track_mutex_);
+        codecConfig.swap(next_codec_config_);
+        mdataStaged = next_mdata_staged_;
+        gaplessMdata = next_mdata_;
+        next_mdata_staged_ = false;
+    }
+
+    // only staged for playback, see setParameters
+    if (!codecConfig.empty()) {
+        status = applyCodecConfig((pal_param_payload *)codecConfig.data(),
+                                  PAL_AUDIO_OUTPUT);
+        if (status)
+            PAL_ERR(LOG_TAG, "failed to apply next track codec config %d", status);
+    }
+
+    if (mdataStaged) {
+        mdata.encoder_delay = gaplessMdata.encoderDelay;
+        mdata.encoder_padding = gaplessMdata.encoderPadding;
+        status = compress_set_gapless_metadata(compress, &mdata);
+        if (status)
+            PAL_ERR(LOG_TAG, "failed to apply next track metadata %d", status);
+    }
+
+    return status;
+}
+
+void SessionAlsaCompress::clearNextTrackConfig()
+{
+    std::lock_guard<std::mutex> lck(next_track_mutex_);
+
+    next_codec_config_.clear();
+    next_mdata_staged_ = false;
+}
+
 int SessionAlsaCompress::drain(pal_drain_type_t type)
 {
     std::shared_ptr<offload_msg> msg;
@@ -2538,6 +2652,18 @@ int SessionAlsaCompress::getTimestamp(struct pal_session_time *stime)
     return status;
 }
 
+int SessionAlsaCompress::waitForDspProcessed(uint32_t durationUs)
+{
+    // nothing is rendering before the first write
+    if (!playback_started)
+        return 0;
+
+    if (!spr_miid)
+        return Session::waitForDspProcessed(durationUs);
+
+    return waitForSessionTime(durationUs);
+}
+
 int SessionAlsaCompress::setECRef(Stream *s __unused, std::shared_ptr<Device> rx_dev __unused, bool is_enable __unused)
 {
     int status = 0;
@@ -50,6 +50,7 @@
 #include "SessionAlsaUtils.h"
 #include "Stream.h"
 #include "ResourceManager.h"
+#include "PalReactor.h"
 #include "detection_cmn_api.h"
 #include "acd_api.h"
 #include "asr_module_calibration_api.h"
@@ -1081,6 +1082,8 @@ int SessionAlsaPcm::start(Stream * s)
                 config.channels, config.format);
             config.period_count = out_buf_count;
         }
+        if (!SessionAlsaUtils::isMmapUsecase(sAttr))
+            applyBufferTuning(s, sAttr.type, &config);
         config.start_threshold = 0;
         config.stop_threshold = 0;
         config.silence_threshold = 0;
@@ -1708,6 +1711,7 @@ silence_det_setup_done:
                     goto exit;
                 }
                 PAL_INFO(LOG_TAG, "miid : %x id = %d\n", miid, pcmDevIds.at(0));
+                hapticsGenMiid = miid;
 
                 if (sAttr.info.opt_stream_info.haptics_type == PAL_STREAM_HAPTICS_RINGTONE) {
                     hpCnfg = (pal_param_haptics_cnfg_t *) calloc(1, sizeof(pal_param_haptics_cnfg_t));
@@ -2211,11 +2215,13 @@ int SessionAlsaPcm::stop(Stream * s)
     int DeviceId;
 
     PAL_DBG(LOG_TAG, "Enter");
+    hapticsGenMiid = 0;
     status = s->getStreamAttributes(&sAttr);
     if (status != 0) {
         PAL_ERR(LOG_TAG, "stream get attributes failed");
         return status;
     }
+    bufTuner.stop();
     switch (sAttr.direction) {
         case PAL_AUDIO_INPUT:
             if (pcm && isActive()) {
@@ -2665,8 +2671,8 @@ int SessionAlsaPcm::disconnectSessionDevice(Stream *streamHandle,
             PAL_ERR(LOG_TAG, "Error notifying Ultrasound tone renderer "
                     "format change START. status = %d", status);
         } else {
-            /*sleep for 20ms to wait for EOS propagation to HWEP*/
-            usleep(20000);
+            /*wait for EOS propagation to HWEP*/
+            waitForDspProcessed(20000);
         }
     }
 
@@ -2688,8 +2694,7 @@ int SessionAlsaPcm::disconnectSessionDevice(Stream *streamHandle,
                 if (0 != status) {
                     PAL_ERR(LOG_TAG, "SetParameters failed for Rampdown, status = %d", status);
                 }
-                /* TODO: Need to adjust the delay based on requirement */
-                usleep(20000);
+                waitForDspProcessed(20000);
             }
 
             status = SessionAlsaUtils::disconnectSessionDevice(streamHandle, streamType, rm,
@@ -2905,6 +2910,8 @@ int SessionAlsaPcm::read(Stream *s, int tag __unused, struct pal_buffer *buf, in
         bytesRead += pcmReadSize;
     }
 
+    if (!status && bytesRead)
+        bufTuner.onTransfer(pcm_bytes_to_frames(pcm, bytesRead));
     *size = bytesRead;
     PAL_VERBOSE(LOG_TAG, "exit bytesRead:%d status:%d ", bytesRead, status);
     return status;
@@ -3001,11 +3008,63 @@ int SessionAlsaPcm::write(Stream *s, int tag, struct pal_buffer *buf, int * size
     }
     bytesWritten += sizeWritten;
     *size = bytesWritten;
+    bufTuner.onTransfer(pcm_bytes_to_frames(pcm, bytesWritten));
 exit:
     PAL_VERBOSE(LOG_TAG, "exit status: %d", status);
     return status;
 }
 
+/*
+ * Picks the period of a pcm about to be opened. The event is raised only
+ * when the period differs from the previous open, or from the client
+ * buffer size on the first one. It is delivered from the reactor, as the
+ * caller holds the stream and graph locks while opening the pcm.
+ */
+void SessionAlsaPcm::applyBufferTuning(Stream *s, pal_stream_type_t type,
+                                       struct pcm_config *config)
+{
+    struct pal_event_buffer_config_payload payload = {};
+    size_t lastPeriod = tunedPeriodFrames ? tunedPeriodFrames : config->period_size;
+
+    config->period_size = bufTuner.start(type, config->rate, config->period_size,
+                                         config->period_count);
+    tunedPeriodFrames = config->period_size;
+    if (config->period_size == lastPeriod || !config->rate)
+        return;
+
+    payload.period_frames = config->period_size;
+    payload.period_count = config->period_count;
+    payload.latency_us = (uint32_t)((uint64_t)config->period_size * config->period_count *
+                                    1000000ULL / config->rate);
+    PAL_INFO(LOG_TAG, "period %zu -> %u frames, latency %u us", lastPeriod,
+             payload.period_frames, payload.latency_us);
+
+    if (!s->streamCb)
+        return;
+
+    std::shared_ptr<ResourceManager> resMgr = rm;
+    if (!PalReactor::getInstance()->postDelayed(0, [resMgr, s, payload]() mutable {
+            resMgr->lockActiveStream();
+            if (!resMgr->isActiveStream(reinterpret_cast<pal_stream_handle_t *>(s)) ||
+                resMgr->increaseStreamUserCounter(s)) {
+                resMgr->unlockActiveStream();
+                return;
+            }
+            resMgr->unlockActiveStream();
+
+            if (s->streamCb)
+                s->streamCb(reinterpret_cast<pal_stream_handle_t *>(s),
+                            PAL_STREAM_CBK_EVENT_BUFFER_CONFIG, (uint32_t *)&payload,
+                            sizeof(payload), s->cookie);
+
+            resMgr->lockActiveStream();
+            resMgr->decreaseStreamUserCounter(s);
+            resMgr->unlockActiveStream();
+        }, true)) {
+        PAL_ERR(LOG_TAG, "failed to post buffer config event");
+    }
+}
+
 int SessionAlsaPcm::readBufferInit(Stream * /*streamHandle*/, size_t /*noOfBuf*/, size_t /*bufSize*/,
                                    int /*flag*/)
 {
@@ -3391,13 +3450,17 @@ int SessionAlsaPcm::setParameters(Stream *streamHandle, int tagId, uint32_t para
                          HapticsCnfg->buffer_size);
             }
             if (isActive()) {
-                status = SessionAlsaUtils::getModuleInstanceId(mixer, device,
-                                      rxAifBackEnds[0].second.data(), MODULE_HAPTICS_GEN, &miid);
-                if (status != 0) {
-                    PAL_ERR(LOG_TAG, "getModuleInstanceId failed");
-                    free(hpCnfg);
-                    return status;
+                if (!hapticsGenMiid) {
+                    status = SessionAlsaUtils::getModuleInstanceId(mixer, device,
+                                      rxAifBackEnds[0].second.data(), MODULE_HAPTICS_GEN,
+                                      &hapticsGenMiid);
+                    if (status != 0) {
+                        PAL_ERR(LOG_TAG, "getModuleInstanceId failed");
+                        free(hpCnfg);
+                        return status;
+                    }
                 }
+                miid = hapticsGenMiid;
                 if (hpCnfg != NULL) {
                     if (hpCnfg->mode == PAL_STREAM_HAPTICS_PCM) {
                         builder->payloadHapticsDevPConfig(&paramData, &paramSize,
@@ -3411,7 +3474,9 @@ int SessionAlsaPcm::setParameters(Stream *streamHandle, int tagId, uint32_t para
                             freeCustomPayload(&paramData, &paramSize);
                         }
                     }
-                    builder->payloadHapticsDevPConfig(&paramData, &paramSize,
+                    if (PayloadBuilder::getCompiledHapticsPayload(hpCnfg, miid,
+                                               &paramData, &paramSize))
+                        builder->payloadHapticsDevPConfig(&paramData, &paramSize,
                                miid, PARAM_ID_HAPTICS_WAVE_DESIGNER_CFG,(void *)hpCnfg);
                     if (paramSize) {
                         status = SessionAlsaUtils::setMixerParameter(mixer, device,
@@ -3990,6 +4055,25 @@ int SessionAlsaPcm::getTimestamp(struct pal_session_time *stime)
     return status;
 }
 
+int SessionAlsaPcm::waitForDspProcessed(uint32_t durationUs)
+{
+    if (!isActive())
+        return 0;
+
+    if (!spr_miid && !sprUnavailable) {
+        if (pcmDevIds.empty() || rxAifBackEnds.empty() ||
+            SessionAlsaUtils::getModuleInstanceId(mixer, pcmDevIds.at(0),
+                rxAifBackEnds[0].second.data(), STREAM_SPR, &spr_miid)) {
+            PAL_DBG(LOG_TAG, "no SPR in graph, DSP waits sleep instead");
+            sprUnavailable = true;
+        }
+    }
+    if (!spr_miid)
+        return Session::waitForDspProcessed(durationUs);
+
+    return waitForSessionTime(durationUs);
+}
+
 int SessionAlsaPcm::drain(pal_drain_type_t type __unused)
 {
     return 0;
@@ -1350,7 +1350,7 @@ silence_det_setup_done:
     if (!ssr_trigger_enable ||
         !ResourceManager::isPalSsrTriggerEnabled) {
         setPopSuppressorMute(s);
-        usleep(POP_SUPPRESSOR_RAMP_DELAY);
+        waitForDspProcessed(POP_SUPPRESSOR_RAMP_DELAY);
     }
 
     if (pcmRx && isActive()) {
@@ -2139,7 +2139,7 @@ int SessionAlsaVoice::disconnectSessionDevice(Stream *streamHandle,
         /*config mute on pop suppressor*/
         if (streamHandle->getCurState() != STREAM_INIT) {
             setPopSuppressorMute(streamHandle);
-            usleep(POP_SUPPRESSOR_RAMP_DELAY);
+            waitForDspProcessed(POP_SUPPRESSOR_RAMP_DELAY);
         }
 
         /*if HW sidetone is enable disable it */
@@ -44,6 +44,7 @@
 #include "Stream.h"
 #include "SoundTriggerPlatformInfo.h"
 #include "VoiceUIInterface.h"
+#include "PalThreadPolicy.h"
 
 #define CNN_BUFFER_LENGTH 10000
 #define CNN_FRAME_SIZE 320
@@ -59,6 +60,7 @@ void SoundTriggerEngineCapi::BufferThreadLoop(
     int32_t detection_state = ENGINE_IDLE;
 
     PAL_DBG(LOG_TAG, "Enter");
+    PalThreadPolicy::apply(PalThreadPolicy::ST_BUFFER);
     if (!capi_engine) {
         PAL_ERR(LOG_TAG, "Invalid sound trigger capi engine");
         return;
@@ -46,6 +46,7 @@
 #include "SoundTriggerPlatformInfo.h"
 #include "VoiceUIInterface.h"
 #include "sh_mem_pull_push_mode_api.h"
+#include "PalThreadPolicy.h"
 
 // TODO: find another way to print debug logs by default
 #define ST_DBG_LOGS
@@ -71,6 +72,7 @@ std::map<SoundTriggerEngineGsl*, int> SoundTriggerEngineGsl::eng_det_stat_map_;
 void SoundTriggerEngineGsl::EventProcessingThread(
     SoundTriggerEngineGsl *gsl_engine) {
 
+    PalThreadPolicy::apply(PalThreadPolicy::ST_EVENT);
     if (!gsl_engine) {
         PAL_ERR(LOG_TAG, "Invalid sound trigger engine");
         return;
@@ -42,6 +42,7 @@
 #include <math.h>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <exception>
 #include <semaphore.h>
 #include <errno.h>
@@ -138,6 +139,9 @@ typedef enum {
  */
 #define SSR_RECOVERY 10000
 
+/* Dropped-buffer clock resyncs to now when the client fell this far behind */
+#define DROP_CLOCK_MAX_LAG_US (100*1000)
+
 /* Soft pause has to wait for ramp period to ensure volume stepping finishes.
  * This period of time was previously consumed in elite before acknowleging
  * pause completion. But it's not the case in Gecko.
@@ -151,6 +155,17 @@ typedef enum {
 #define MUTE_RAMP_PERIOD (40*1000)
 #define DEFAULT_RAMP_PERIOD 0x28 //40ms
 
+/*
+ * Pending update bits for the coalescing volume/mute queue. The batching
+ * window is bounded by the default volume ramp so the DSP ramp always
+ * spans the updates that were superseded within one window.
+ */
+#define PARAM_UPDATE_VOLUME 0x1
+#define PARAM_UPDATE_MUTE 0x2
+#define PARAM_UPDATE_MIN_PERIOD_US (5*1000)
+#define PARAM_UPDATE_MAX_PERIOD_US (DEFAULT_RAMP_PERIOD*1000)
+#define PARAM_UPDATE_WAIT_MS 200
+
 class Device;
 class ResourceManager;
 class Session;
@@ -189,7 +204,36 @@ protected:
     bool mDutyCycleEnable = false;
     bool skipSSRHandling = false;
     sem_t mInUse;
+    /* coalescing queue for volume/mute updates, flushed by mParamUpdateThread */
+    std::thread mParamUpdateThread;
+    std::mutex mParamUpdateMutex;
+    std::condition_variable mParamUpdateCV;
+    uint32_t mPendingParamMask = 0;
+    bool mPendingMuteState = false;
+    uint32_t mCoalescedParamCount = 0;
+    uint64_t mParamUpdateSeq = 0;
+    uint64_t mParamUpdateDoneSeq = 0;
+    /* first flush failure not yet returned to a caller */
+    int32_t mParamUpdateStatus = 0;
+    bool mParamUpdateExit = false;
+    /* virtual clock pacing buffers dropped while card is down or a2dp paused */
+    struct timespec mDropDeadline = {0, 0};
+    bool mDropClockRunning = false;
     int connectToDefaultDevice(Stream* streamHandle, uint32_t dir);
+    uint64_t queueParamUpdate(uint32_t mask, bool muteState);
+    int32_t takeParamUpdateStatus_l();
+    void cancelParamUpdate(uint32_t mask);
+    void stopParamUpdateThread();
+    void paramUpdateThreadLoop();
+    uint32_t getParamUpdatePeriodUs();
+    /* sleeps to the next absolute deadline, call without mStreamMutex held
+     * so control calls are not blocked while buffers are being dropped.
+     */
+    void paceDroppedBuffer(uint64_t durationUs);
+    void resetDropClock() { mDropClockRunning = false; }
+    /* called with mStreamMutex held to push the coalesced updates to DSP */
+    virtual int32_t flushParamUpdates_l(uint32_t mask __unused, bool muteState __unused,
+                                        uint32_t coalesced __unused) { return 0; }
 public:
     virtual ~Stream() {};
     struct pal_volume_data* mVolumeData = NULL;
@@ -214,6 +258,14 @@ public:
     virtual int32_t setVolume(struct pal_volume_data *volume) = 0;
     virtual int32_t mute(bool state) = 0;
     virtual int32_t mute_l(bool state) = 0;
+    /*
+     * Non-blocking variants, the update reaches DSP within one period.
+     * fence is 0 when the update already completed. A failed flush is
+     * returned by the next async call or waitParamUpdate.
+     */
+    virtual int32_t setVolumeAsync(struct pal_volume_data *volume, uint64_t *fence);
+    virtual int32_t muteAsync(bool state, uint64_t *fence);
+    int32_t waitParamUpdate(uint64_t fence, uint32_t timeoutMs);
     virtual int32_t getDeviceMute(pal_stream_direction_t dir, bool *state) {return 0;};
     virtual int32_t setDeviceMute(pal_stream_direction_t dir, bool state) {return 0;};
     virtual int32_t pause() = 0;
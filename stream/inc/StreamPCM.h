@@ -56,7 +56,9 @@ public:
    int32_t prepare() override;
    int32_t setStreamAttributes( struct pal_stream_attributes *sattr) override;
    int32_t setVolume( struct pal_volume_data *volume) override;
+   int32_t setVolumeAsync(struct pal_volume_data *volume, uint64_t *fence) override;
    int32_t mute(bool state) override;
+   int32_t muteAsync(bool state, uint64_t *fence) override;
    int32_t mute_l(bool state) override;
    int32_t getDeviceMute(pal_stream_direction_t dir, bool *state) override;
    int32_t setDeviceMute(pal_stream_direction_t dir, bool state) override;
@@ -83,6 +85,12 @@ public:
    static int32_t isSampleRateSupported(uint32_t sampleRate);
    static int32_t isChannelSupported(uint32_t numChannels);
    static int32_t isBitWidthSupported(uint32_t bitWidth);
+protected:
+   int32_t flushParamUpdates_l(uint32_t mask, bool muteState, uint32_t coalesced) override;
+private:
+   int32_t cacheVolume(struct pal_volume_data *volume);
+   int32_t applyVolume_l();
+   bool isVolumeApplicable();
 };
 
 #endif//STREAMPCM_H_
@@ -42,6 +42,8 @@
 #include "PalRingBuffer.h"
 #include "SoundTriggerEngine.h"
 #include "VoiceUIPlatformInfo.h"
+#include "SoundModelCache.h"
+#include "PalReactor.h"
 #include "detection_cmn_api.h"
 #include "mma_api.h"
 
@@ -544,19 +546,18 @@ private:
     std::condition_variable abort_event_cond_;
     int32_t notifyClient(uint32_t detection);
 
-    static void TimerThread(StreamSoundTrigger& st_stream);
     void PostDelayedStop();
     void CancelDelayedStop();
     void InternalStopRecognition();
     int32_t DisconnectEvent(std::shared_ptr<StEventConfig> ev_cfg,
           bool device_switch_event = false);
     int32_t ConnectEvent(std::shared_ptr<StEventConfig> ev_cfg);
-    std::thread timer_thread_;
     std::mutex timer_mutex_;
-    std::condition_variable timer_start_cond_;
-    std::condition_variable timer_wait_cond_;
-    bool timer_stop_waiting_;
-    bool exit_timer_thread_;
+    PalReactor::TimerId delayed_stop_timer_;
+    // generation of the latest stop timer, earlier ones never clear it
+    uint32_t stop_timer_gen_;
+    // all stop timers which may still run, waited for on destruction
+    std::map<uint32_t, PalReactor::TimerId> stop_timers_;
     bool pending_stop_;
     bool paused_;
     bool device_opened_;
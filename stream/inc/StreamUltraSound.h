@@ -50,6 +50,7 @@ public:
    int32_t setParameters(uint32_t param_id, void *payload);
    int32_t start();
    int32_t stop();
+   // may drop mStreamMutex while the previous gain ramps down
    int32_t setUltraSoundGain_l(pal_ultrasound_gain_t new_gain);
    int32_t setUltraSoundGain(pal_ultrasound_gain_t new_gain);
 private:
@@ -33,6 +33,7 @@
 
 #define LOG_TAG "PAL: Stream"
 #include <semaphore.h>
+#include <time.h>
 #include "Stream.h"
 #include "StreamPCM.h"
 #include "StreamInCall.h"
@@ -2477,3 +2478,203 @@ bool Stream::isStreamSSRDownFeasibile()
             is_ssr_down_feasible);
     return is_ssr_down_feasible;
 }
+
+int32_t Stream::setVolumeAsync(struct pal_volume_data *volume, uint64_t *fence)
+{
+    if (fence)
+        *fence = 0;
+
+    return setVolume(volume);
+}
+
+int32_t Stream::muteAsync(bool state, uint64_t *fence)
+{
+    if (fence)
+        *fence = 0;
+
+    return mute(state);
+}
+
+uint32_t Stream::getParamUpdatePeriodUs()
+{
+    uint32_t periodUs = PARAM_UPDATE_MAX_PERIOD_US;
+    uint32_t frameSize = 0;
+    uint32_t sampleRate = 0;
+
+    if (!mStreamAttr)
+        return periodUs;
+
+    if (mStreamAttr->direction == PAL_AUDIO_INPUT) {
+        frameSize = (mStreamAttr->in_media_config.bit_width / 8) *
+                    mStreamAttr->in_media_config.ch_info.channels;
+        sampleRate = mStreamAttr->in_media_config.sample_rate;
+        if (frameSize && sampleRate)
+            periodUs = (uint64_t)inBufSize * 1000000 / frameSize / sampleRate;
+    } else {
+        frameSize = (mStreamAttr->out_media_config.bit_width / 8) *
+                    mStreamAttr->out_media_config.ch_info.channels;
+        sampleRate = mStreamAttr->out_media_config.sample_rate;
+        if (frameSize && sampleRate)
+            periodUs = (uint64_t)outBufSize * 1000000 / frameSize / sampleRate;
+    }
+
+    return std::min(std::max(periodUs, (uint32_t)PARAM_UPDATE_MIN_PERIOD_US),
+                    (uint32_t)PARAM_UPDATE_MAX_PERIOD_US);
+}
+
+uint64_t Stream::queueParamUpdate(uint32_t mask, bool muteState)
+{
+    std::unique_lock<std::mutex> lck(mParamUpdateMutex);
+
+    if (mPendingParamMask & mask)
+        mCoalescedParamCount++;
+
+    mPendingParamMask |= mask;
+    if (mask & PARAM_UPDATE_MUTE)
+        mPendingMuteState = muteState;
+
+    if (!mParamUpdateThread.joinable()) {
+        mParamUpdateExit = false;
+        mParamUpdateThread = std::thread(&Stream::paramUpdateThreadLoop, this);
+    }
+
+    mParamUpdateCV.notify_all();
+    return ++mParamUpdateSeq;
+}
+
+/* Call with mStreamMutex held, the flush of a batch holds it throughout */
+void Stream::cancelParamUpdate(uint32_t mask)
+{
+    std::unique_lock<std::mutex> lck(mParamUpdateMutex);
+
+    mPendingParamMask &= ~mask;
+    // superseded by a synchronous update, nothing left to wait for
+    if (!mPendingParamMask) {
+        mParamUpdateDoneSeq = mParamUpdateSeq;
+        mParamUpdateCV.notify_all();
+    }
+}
+
+int32_t Stream::takeParamUpdateStatus_l()
+{
+    int32_t status = mParamUpdateStatus;
+
+    mParamUpdateStatus = 0;
+    return status;
+}
+
+int32_t Stream::waitParamUpdate(uint64_t fence, uint32_t timeoutMs)
+{
+    std::unique_lock<std::mutex> lck(mParamUpdateMutex);
+
+    if (!mParamUpdateCV.wait_for(lck, std::chrono::milliseconds(timeoutMs),
+            [&] { return mParamUpdateDoneSeq >= fence; })) {
+        PAL_ERR(LOG_TAG, "timed out waiting for param update %llu, done %llu",
+                (unsigned long long)fence, (unsigned long long)mParamUpdateDoneSeq);
+        return -ETIMEDOUT;
+    }
+
+    return takeParamUpdateStatus_l();
+}
+
+void Stream::stopParamUpdateThread()
+{
+    std::unique_lock<std::mutex> lck(mParamUpdateMutex);
+
+    if (!mParamUpdateThread.joinable())
+        return;
+
+    mParamUpdateExit = true;
+    mParamUpdateCV.notify_all();
+    lck.unlock();
+    mParamUpdateThread.join();
+}
+
+void Stream::paramUpdateThreadLoop()
+{
+    uint32_t mask = 0;
+    uint32_t coalesced = 0;
+    uint64_t seq = 0;
+    int32_t status = 0;
+    bool muteState = false;
+    std::unique_lock<std::mutex> lck(mParamUpdateMutex);
+
+    PAL_DBG(LOG_TAG, "Enter. stream %pK", this);
+    while (!mParamUpdateExit) {
+        mParamUpdateCV.wait(lck, [&] { return mParamUpdateExit || mPendingParamMask; });
+        if (mParamUpdateExit)
+            break;
+
+        /* hold the batch open for one period so that updates issued at
+         * UI frame rate supersede each other instead of reaching DSP.
+         */
+        mParamUpdateCV.wait_for(lck, std::chrono::microseconds(getParamUpdatePeriodUs()),
+                                [&] { return mParamUpdateExit; });
+        if (mParamUpdateExit)
+            break;
+
+        /* take the batch under mStreamMutex, a synchronous update cancelling
+         * it meanwhile must not be overwritten by stale values.
+         */
+        lck.unlock();
+        mStreamMutex.lock();
+        lck.lock();
+        mask = mPendingParamMask;
+        muteState = mPendingMuteState;
+        coalesced = mCoalescedParamCount;
+        seq = mParamUpdateSeq;
+        mPendingParamMask = 0;
+        mCoalescedParamCount = 0;
+        lck.unlock();
+
+        status = 0;
+        if (mask)
+            status = flushParamUpdates_l(mask, muteState, coalesced);
+        mStreamMutex.unlock();
+
+        lck.lock();
+        if (status && !mParamUpdateStatus)
+            mParamUpdateStatus = status;
+        if (seq > mParamUpdateDoneSeq)
+            mParamUpdateDoneSeq = seq;
+        mParamUpdateCV.notify_all();
+    }
+
+    /* stream is going away, pending updates stay cached in the stream */
+    mPendingParamMask = 0;
+    mCoalescedParamCount = 0;
+    mParamUpdateDoneSeq = mParamUpdateSeq;
+    mParamUpdateCV.notify_all();
+    PAL_DBG(LOG_TAG, "Exit. stream %pK", this);
+}
+
+void Stream::paceDroppedBuffer(uint64_t durationUs)
+{
+    struct timespec now;
+    int64_t lagUs = 0;
+    int ret = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (mDropClockRunning) {
+        lagUs = ((int64_t)now.tv_sec - mDropDeadline.tv_sec) * 1000000 +
+                (now.tv_nsec - mDropDeadline.tv_nsec) / 1000;
+    }
+    /* start the clock on the first dropped buffer, or restart it when the
+     * client stalled so that it is not bursted through the backlog.
+     */
+    if (!mDropClockRunning || lagUs > DROP_CLOCK_MAX_LAG_US) {
+        mDropDeadline = now;
+        mDropClockRunning = true;
+    }
+
+    mDropDeadline.tv_sec += durationUs / 1000000;
+    mDropDeadline.tv_nsec += (durationUs % 1000000) * 1000;
+    if (mDropDeadline.tv_nsec >= 1000000000) {
+        mDropDeadline.tv_sec++;
+        mDropDeadline.tv_nsec -= 1000000000;
+    }
+
+    do {
+        ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &mDropDeadline, NULL);
+    } while (ret == EINTR);
+}
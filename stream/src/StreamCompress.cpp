@@ -804,11 +804,24 @@ int32_t StreamCompress::setParameters(uint32_t param_id, void *payload)
                 if (setConfigStatus) {
                     PAL_INFO(LOG_TAG, "DevicePP Mute failed");
                 }
-                usleep(MUTE_RAMP_PERIOD); // Wait for mute to ramp down
+                mStreamMutex.unlock();
+                session->waitForDspProcessed(MUTE_RAMP_PERIOD); // Wait for mute to ramp down
+                mStreamMutex.lock();
+                if (currentState == STREAM_IDLE || !session) {
+                    PAL_DBG(LOG_TAG, "stream closed during mute ramp, skip rotation");
+                    status = -EINVAL;
+                    break;
+                }
                 status = session->setParameters(this, 0,
                                                 PAL_PARAM_ID_DEVICE_ROTATION,
                                                 payload);
-                usleep(MUTE_RAMP_PERIOD); // Wait for channel swap to take affect
+                mStreamMutex.unlock();
+                session->waitForDspProcessed(MUTE_RAMP_PERIOD); // Wait for channel swap to take affect
+                mStreamMutex.lock();
+                if (currentState == STREAM_IDLE || !session) {
+                    PAL_DBG(LOG_TAG, "stream closed during channel swap, skip unmute");
+                    break;
+                }
                 setConfigStatus = session->setConfig(this, MODULE, DEVICEPP_UNMUTE);
                 if (setConfigStatus) {
                     PAL_INFO(LOG_TAG, "DevicePP Unmute failed");
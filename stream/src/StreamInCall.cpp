@@ -490,6 +490,7 @@ int32_t  StreamInCall::read(struct pal_buffer* buf)
 {
     int32_t status = 0;
     int32_t size;
+    uint64_t dropUs = 0;
     PAL_VERBOSE(LOG_TAG, "Enter. session handle - %pK, state %d",
             session, currentState);
 
@@ -511,7 +512,7 @@ int32_t  StreamInCall::read(struct pal_buffer* buf)
         }
         size = buf->size;
         memset(buf->buffer, 0, size);
-        usleep((uint64_t)size * 1000000 / streamSize / sampleRate);
+        dropUs = (uint64_t)size * 1000000 / streamSize / sampleRate;
         PAL_DBG(LOG_TAG, "Sound card offline, dropped buffer size - %d", size);
         status = size;
         goto exit;
@@ -544,11 +545,14 @@ int32_t  StreamInCall::read(struct pal_buffer* buf)
         status = -EINVAL;
         goto exit;
     }
+    resetDropClock();
     mStreamMutex.unlock();
     PAL_VERBOSE(LOG_TAG, "Exit. session read successful size - %d", size);
     return size;
 exit :
     mStreamMutex.unlock();
+    if (dropUs)
+        paceDroppedBuffer(dropUs);
     PAL_VERBOSE(LOG_TAG, "Exit session read failed status %d", status);
     return status;
 }
@@ -580,14 +584,15 @@ int32_t  StreamInCall::write(struct pal_buffer* buf)
             return -EINVAL;
         }
         size = buf->size;
-        usleep((uint64_t)size * 1000000 / frameSize / sampleRate);
-        PAL_DBG(LOG_TAG, "dropped buffer size - %d", size);
         mStreamMutex.unlock();
+        paceDroppedBuffer((uint64_t)size * 1000000 / frameSize / sampleRate);
+        PAL_DBG(LOG_TAG, "dropped buffer size - %d", size);
         PAL_VERBOSE(LOG_TAG, "Exit size: %d", size);
         return size;
     }
 
     if (currentState == STREAM_STARTED) {
+        resetDropClock();
         status = session->write(this, SHMEM_ENDPOINT, buf, &size, 0);
         mStreamMutex.unlock();
         if (0 != status) {
@@ -65,6 +65,8 @@ StreamPCM::StreamPCM(const struct pal_stream_attributes *sattr, struct pal_devic
     }
 
     session = NULL;
+    streamCb = NULL;
+    cookie = 0;
     mGainLevel = -1;
     std::shared_ptr<Device> dev = nullptr;
     mStreamAttr = (struct pal_stream_attributes *)nullptr;
@@ -322,6 +324,8 @@ exit:
 int32_t  StreamPCM::close()
 {
     int32_t status = 0;
+
+    stopParamUpdateThread();
     mStreamMutex.lock();
 
     if (currentState == STREAM_IDLE) {
@@ -381,6 +385,7 @@ int32_t  StreamPCM::close()
 
 StreamPCM::~StreamPCM()
 {
+    stopParamUpdateThread();
     cachedState = STREAM_IDLE;
     ResourceManager::setProxyRecordActive(false);
 
@@ -874,18 +879,14 @@ exit:
     return status;
 }
 
-int32_t StreamPCM::setVolume(struct pal_volume_data *volume)
+int32_t StreamPCM::cacheVolume(struct pal_volume_data *volume)
 {
     int32_t status = 0;
-    struct volume_set_param_info vol_set_param_info;
     uint8_t volSize = 0;
-    bool forceSetParameters = false;
 
-    PAL_DBG(LOG_TAG, "Enter. session handle - %pK", session);
     if (!volume || (volume->no_of_volpair == 0)) {
        PAL_ERR(LOG_TAG, "Invalid arguments");
-       status = -EINVAL;
-       goto exit;
+       return -EINVAL;
     }
 
     // if already allocated free and reallocate
@@ -899,7 +900,7 @@ int32_t StreamPCM::setVolume(struct pal_volume_data *volume)
     if (!mVolumeData) {
         status = -ENOMEM;
         PAL_ERR(LOG_TAG, "failed to calloc for volume data");
-        goto exit;
+        return status;
     }
 
     /* Allow caching of stream volume as part of mVolumeData
@@ -907,65 +908,103 @@ int32_t StreamPCM::setVolume(struct pal_volume_data *volume)
      */
     ar_mem_cpy(mVolumeData, volSize, volume, volSize);
     for (int32_t i = 0; i < (mVolumeData->no_of_volpair); i++) {
-        if ((i > 0) &&
-            (abs(mVolumeData->volume_pair[0].vol -
-                mVolumeData->volume_pair[i].vol) > VOLUME_TOLERANCE)) {
-                forceSetParameters = true;
-        }
         PAL_INFO(LOG_TAG, "Volume payload mask:%x vol:%f",
                       (mVolumeData->volume_pair[i].channel_mask), (mVolumeData->volume_pair[i].vol));
     }
 
-    if (a2dpMuted) {
-        PAL_DBG(LOG_TAG, "a2dp muted, just cache volume update");
-        goto exit;
+    return status;
+}
+
+bool StreamPCM::isVolumeApplicable()
+{
+    return (rm->cardState == CARD_STATUS_ONLINE) && (currentState != STREAM_IDLE)
+            && (currentState != STREAM_INIT) && (!isPaused);
+}
+
+int32_t StreamPCM::applyVolume_l()
+{
+    int32_t status = 0;
+    struct volume_set_param_info vol_set_param_info;
+    uint8_t volSize = 0;
+    bool forceSetParameters = false;
+
+    if (!mVolumeData)
+        return -EINVAL;
+
+    volSize = sizeof(uint32_t) + (sizeof(struct pal_channel_vol_kv) * (mVolumeData->no_of_volpair));
+    for (int32_t i = 1; i < (mVolumeData->no_of_volpair); i++) {
+        if (abs(mVolumeData->volume_pair[0].vol -
+                mVolumeData->volume_pair[i].vol) > VOLUME_TOLERANCE) {
+            forceSetParameters = true;
+            break;
+        }
     }
 
     memset(&vol_set_param_info, 0, sizeof(struct volume_set_param_info));
     rm->getVolumeSetParamInfo(&vol_set_param_info);
-    if ((rm->cardState == CARD_STATUS_ONLINE) && (currentState != STREAM_IDLE)
-            && (currentState != STREAM_INIT) && (!isPaused)) {
-        bool isStreamAvail = (find(vol_set_param_info.streams_.begin(),
-                    vol_set_param_info.streams_.end(), mStreamAttr->type) !=
-                    vol_set_param_info.streams_.end());
-        if (!forceSetParameters && mVolumeData->volume_pair[0].vol == 0.0f &&
-            !vol_set_param_info.isVolumeUsingSetParam) {
-            //if the volume is 0, force settting parameters as well
-            if (rm->isCRSCallEnabled) {
-                status = session->setConfig(this, MODULE, CRS_CALL_VOLUME, RX_HOSTLESS);
-            } else {
-                status = session->setConfig(this, CALIBRATION, TAG_STREAM_VOLUME);
-            }
-            forceSetParameters = true;
+    bool isStreamAvail = (find(vol_set_param_info.streams_.begin(),
+                vol_set_param_info.streams_.end(), mStreamAttr->type) !=
+                vol_set_param_info.streams_.end());
+    if (!forceSetParameters && mVolumeData->volume_pair[0].vol == 0.0f &&
+        !vol_set_param_info.isVolumeUsingSetParam) {
+        //if the volume is 0, force settting parameters as well
+        if (rm->isCRSCallEnabled) {
+            status = session->setConfig(this, MODULE, CRS_CALL_VOLUME, RX_HOSTLESS);
+        } else {
+            status = session->setConfig(this, CALIBRATION, TAG_STREAM_VOLUME);
         }
-        if ((isStreamAvail && vol_set_param_info.isVolumeUsingSetParam) || forceSetParameters) {
-            uint8_t *volPayload = new uint8_t[sizeof(pal_param_payload) + volSize]();
-            pal_param_payload *pld = (pal_param_payload *)volPayload;
-            pld->payload_size = sizeof(struct pal_volume_data);
-            memcpy(pld->payload, mVolumeData, volSize);
-            status = session->setParameters(this, TAG_STREAM_VOLUME,
-                    PAL_PARAM_ID_VOLUME_USING_SET_PARAM, (void *)pld);
-            delete[] volPayload;
-            PAL_DBG(LOG_TAG, "set volume by parameter, status: %d", status);
+        forceSetParameters = true;
+    }
+    if ((isStreamAvail && vol_set_param_info.isVolumeUsingSetParam) || forceSetParameters) {
+        uint8_t *volPayload = new uint8_t[sizeof(pal_param_payload) + volSize]();
+        pal_param_payload *pld = (pal_param_payload *)volPayload;
+        pld->payload_size = sizeof(struct pal_volume_data);
+        memcpy(pld->payload, mVolumeData, volSize);
+        status = session->setParameters(this, TAG_STREAM_VOLUME,
+                PAL_PARAM_ID_VOLUME_USING_SET_PARAM, (void *)pld);
+        delete[] volPayload;
+        PAL_DBG(LOG_TAG, "set volume by parameter, status: %d", status);
+    } else {
+        if (rm->isCRSCallEnabled) {
+            status = session->setConfig(this, MODULE, CRS_CALL_VOLUME, RX_HOSTLESS);
         } else {
-            if (rm->isCRSCallEnabled) {
-                status = session->setConfig(this, MODULE, CRS_CALL_VOLUME, RX_HOSTLESS);
-            } else {
-                status = session->setConfig(this, CALIBRATION, TAG_STREAM_VOLUME);
-            }
+            status = session->setConfig(this, CALIBRATION, TAG_STREAM_VOLUME);
         }
+    }
 
-        if (0 != status) {
-            PAL_ERR(LOG_TAG, "session setConfig for VOLUME_TAG failed with status %d",
-                    status);
-            goto exit;
-        }
-        if (unMutePending) {
-            unMutePending = false;
-            mute_l(false);
-        }
+    if (0 != status) {
+        PAL_ERR(LOG_TAG, "session setConfig for VOLUME_TAG failed with status %d",
+                status);
+        return status;
+    }
+    if (unMutePending) {
+        unMutePending = false;
+        mute_l(false);
+    }
+
+    return status;
+}
+
+int32_t StreamPCM::setVolume(struct pal_volume_data *volume)
+{
+    int32_t status = 0;
+
+    PAL_DBG(LOG_TAG, "Enter. session handle - %pK", session);
+    /* a synchronous update supersedes anything still queued */
+    cancelParamUpdate(PARAM_UPDATE_VOLUME);
+
+    status = cacheVolume(volume);
+    if (0 != status)
+        goto exit;
+
+    if (a2dpMuted) {
+        PAL_DBG(LOG_TAG, "a2dp muted, just cache volume update");
+        goto exit;
     }
 
+    if (isVolumeApplicable())
+        status = applyVolume_l();
+
 exit:
     if (volume) {
         PAL_DBG(LOG_TAG, "Exit. Volume payload No.of vol pair:%d ch mask:%x gain:%f",
@@ -975,10 +1014,91 @@ exit:
     return status;
 }
 
+int32_t StreamPCM::setVolumeAsync(struct pal_volume_data *volume, uint64_t *fence)
+{
+    int32_t status = 0;
+    uint64_t seq = 0;
+
+    if (!rm->isAsyncParamUpdateEnabled)
+        return Stream::setVolumeAsync(volume, fence);
+
+    status = cacheVolume(volume);
+    if (0 != status)
+        goto exit;
+
+    /* volume not applicable now stays cached and is applied on start/resume */
+    if (a2dpMuted || !isVolumeApplicable()) {
+        cancelParamUpdate(PARAM_UPDATE_VOLUME);
+        goto exit;
+    }
+
+    seq = queueParamUpdate(PARAM_UPDATE_VOLUME, false);
+
+exit:
+    if (fence)
+        *fence = seq;
+    if (0 == status) {
+        std::lock_guard<std::mutex> lck(mParamUpdateMutex);
+        status = takeParamUpdateStatus_l();
+        if (0 != status)
+            PAL_ERR(LOG_TAG, "earlier param update failed, status %d", status);
+    }
+    return status;
+}
+
+int32_t StreamPCM::muteAsync(bool state, uint64_t *fence)
+{
+    int32_t status = 0;
+    uint64_t seq = 0;
+
+    if (!rm->isAsyncParamUpdateEnabled)
+        return Stream::muteAsync(state, fence);
+
+    seq = queueParamUpdate(PARAM_UPDATE_MUTE, state);
+    if (fence)
+        *fence = seq;
+
+    std::lock_guard<std::mutex> lck(mParamUpdateMutex);
+    status = takeParamUpdateStatus_l();
+    if (0 != status)
+        PAL_ERR(LOG_TAG, "earlier param update failed, status %d", status);
+
+    return status;
+}
+
+int32_t StreamPCM::flushParamUpdates_l(uint32_t mask, bool muteState, uint32_t coalesced)
+{
+    int32_t status = 0;
+    int32_t ret = 0;
+
+    PAL_DBG(LOG_TAG, "Enter. mask 0x%x mute %d coalesced %u", mask, muteState, coalesced);
+    /* Only the latest cached volume is pushed, the DSP volume ramp
+     * (DEFAULT_RAMP_PERIOD) covers the steps superseded in this window.
+     */
+    if ((mask & PARAM_UPDATE_VOLUME) && !a2dpMuted && isVolumeApplicable()) {
+        status = applyVolume_l();
+        if (0 != status)
+            PAL_ERR(LOG_TAG, "coalesced volume update failed, status %d", status);
+    }
+
+    if (mask & PARAM_UPDATE_MUTE) {
+        ret = mute_l(muteState);
+        if (0 != ret) {
+            PAL_ERR(LOG_TAG, "coalesced mute update failed, status %d", ret);
+            if (0 == status)
+                status = ret;
+        }
+    }
+
+    PAL_DBG(LOG_TAG, "Exit. status %d", status);
+    return status;
+}
+
 int32_t  StreamPCM::read(struct pal_buffer* buf)
 {
     int32_t status = 0;
     int32_t size;
+    uint64_t dropUs = 0;
     PAL_VERBOSE(LOG_TAG, "Enter. session handle - %pK, state %d",
             session, currentState);
 
@@ -1000,7 +1120,7 @@ int32_t  StreamPCM::read(struct pal_buffer* buf)
         }
         size = buf->size;
         memset(buf->buffer, 0, size);
-        usleep((uint64_t)size * 1000000 / streamSize / sampleRate);
+        dropUs = (uint64_t)size * 1000000 / streamSize / sampleRate;
         PAL_DBG(LOG_TAG, "Sound card offline, dropped buffer size - %d", size);
         status = size;
         goto exit;
@@ -1032,11 +1152,14 @@ int32_t  StreamPCM::read(struct pal_buffer* buf)
         status = -EINVAL;
         goto exit;
     }
+    resetDropClock();
     mStreamMutex.unlock();
     PAL_VERBOSE(LOG_TAG, "Exit. session read successful size - %d", size);
     return size;
 exit :
     mStreamMutex.unlock();
+    if (dropUs)
+        paceDroppedBuffer(dropUs);
     PAL_DBG(LOG_TAG, "Exit. session read failed status %d", status);
     return status;
 }
@@ -1070,9 +1193,9 @@ int32_t StreamPCM::write(struct pal_buffer* buf)
             goto exit;
         }
         size = buf->size;
-        usleep((uint64_t)size * 1000000 / frameSize / sampleRate);
-        PAL_DBG(LOG_TAG, "dropped buffer size - %d", size);
         mStreamMutex.unlock();
+        paceDroppedBuffer((uint64_t)size * 1000000 / frameSize / sampleRate);
+        PAL_DBG(LOG_TAG, "dropped buffer size - %d", size);
         PAL_VERBOSE(LOG_TAG, "Exit size: %d", size);
         return size;
     }
@@ -1080,6 +1203,7 @@ int32_t StreamPCM::write(struct pal_buffer* buf)
     // we should allow writes to go through in Start/Pause state as well.
     if ((currentState == STREAM_STARTED) ||
         (currentState == STREAM_PAUSED) ) {
+        resetDropClock();
         status = session->write(this, SHMEM_ENDPOINT, buf, &size, 0);
         mStreamMutex.unlock();
         if (0 != status) {
@@ -1131,13 +1255,18 @@ exit:
     return status;
 }
 
-int32_t  StreamPCM::registerCallBack(pal_stream_callback /*cb*/, uint64_t /*cookie*/)
+int32_t  StreamPCM::registerCallBack(pal_stream_callback cb, uint64_t cookie)
 {
+    // only PAL_STREAM_CBK_EVENT_BUFFER_CONFIG is raised on PCM streams
+    streamCb = cb;
+    this->cookie = cookie;
     return 0;
 }
 
-int32_t  StreamPCM::getCallBack(pal_stream_callback * /*cb*/)
+int32_t  StreamPCM::getCallBack(pal_stream_callback *cb)
 {
+    if (cb)
+        *cb = streamCb;
     return 0;
 }
 
@@ -1250,14 +1379,23 @@ int32_t  StreamPCM::setParameters(uint32_t param_id, void *payload)
                     PAL_INFO(LOG_TAG, "DevicePP Mute failed");
                 }
                 mStreamMutex.unlock();
-                usleep(MUTE_RAMP_PERIOD); // Wait for Mute ramp down to happen
+                session->waitForDspProcessed(MUTE_RAMP_PERIOD); // Wait for Mute ramp down to happen
                 mStreamMutex.lock();
+                if (currentState == STREAM_IDLE || !session) {
+                    PAL_DBG(LOG_TAG, "stream closed during mute ramp, skip rotation");
+                    status = -EINVAL;
+                    break;
+                }
                 status = session->setParameters(this, 0,
                                                 PAL_PARAM_ID_DEVICE_ROTATION,
                                                 payload);
                 mStreamMutex.unlock();
-                usleep(MUTE_RAMP_PERIOD); // Wait for channel swap to take affect
+                session->waitForDspProcessed(MUTE_RAMP_PERIOD); // Wait for channel swap to take affect
                 mStreamMutex.lock();
+                if (currentState == STREAM_IDLE || !session) {
+                    PAL_DBG(LOG_TAG, "stream closed during channel swap, skip unmute");
+                    break;
+                }
                 if (mStreamAttr->type == PAL_STREAM_LOW_LATENCY ||
                     mStreamAttr->type == PAL_STREAM_ULTRA_LOW_LATENCY) {
                     setConfigStatus = session->setConfig(this, MODULE, UNMUTE_TAG);
@@ -1356,6 +1494,7 @@ int32_t StreamPCM::mute(bool state)
     int32_t status = 0;
 
     mStreamMutex.lock();
+    cancelParamUpdate(PARAM_UPDATE_MUTE);
     status = mute_l(state);
     mStreamMutex.unlock();
 
@@ -200,30 +200,30 @@ StreamSoundTrigger::StreamSoundTrigger(struct pal_stream_attributes *sattr,
         paused_ = true;
     }
 
-    timer_thread_ = std::thread(TimerThread, std::ref(*this));
-    timer_stop_waiting_ = false;
-    exit_timer_thread_ = false;
+    delayed_stop_timer_ = 0;
+    stop_timer_gen_ = 0;
 
     PAL_DBG(LOG_TAG, "Exit");
 }
 
 StreamSoundTrigger::~StreamSoundTrigger() {
-    mStreamMutex.lock();
+    std::map<uint32_t, PalReactor::TimerId> timers;
+
     {
         std::lock_guard<std::mutex> lck(timer_mutex_);
-        exit_timer_thread_ = true;
-        timer_stop_waiting_ = true;
-        timer_wait_cond_.notify_one();
-        timer_start_cond_.notify_one();
-    }
-    if (timer_thread_.joinable()) {
-        PAL_DBG(LOG_TAG, "Join timer thread");
-        timer_thread_.join();
+        timers.swap(stop_timers_);
+        delayed_stop_timer_ = 0;
     }
+    // the stop callbacks take mStreamMutex, drain them before locking
+    for (auto &timer : timers)
+        PalReactor::getInstance()->cancelSync(timer.second);
+
+    mStreamMutex.lock();
 
     // clean up properly in case stream is deconstructed without close
     if (cur_state_ != st_idle_)
         UnloadSoundModel();
+    SoundModelCache::getInstance()->Drop(this);
     st_states_.clear();
     engines_.clear();
     mStreamMutex.unlock();
@@ -288,6 +288,7 @@ int32_t StreamSoundTrigger::close() {
     std::shared_ptr<StEventConfig> ev_cfg(new StUnloadEventConfig());
     status = cur_state_->ProcessEvent(ev_cfg);
 
+    SoundModelCache::getInstance()->Drop(this);
     if (sm_config_) {
         free(sm_config_);
         sm_config_ = nullptr;
@@ -993,47 +994,52 @@ void StreamSoundTrigger::InternalStopRecognition() {
     PAL_DBG(LOG_TAG, "Exit, status %d", status);
 }
 
-void StreamSoundTrigger::TimerThread(StreamSoundTrigger& st_stream) {
-    PAL_DBG(LOG_TAG, "Enter");
-
-    std::unique_lock<std::mutex> lck(st_stream.timer_mutex_);
-    while (!st_stream.exit_timer_thread_) {
-        st_stream.timer_start_cond_.wait(lck);
-        if (st_stream.exit_timer_thread_)
-            break;
-
-        if (st_stream.GetCurrentStateId() == ST_STATE_BUFFERING &&
-            !st_stream.second_stage_processing_) {
-            st_stream.timer_wait_cond_.wait_for(lck,
-                std::chrono::milliseconds(ST_LAB_DEFERRED_STOP_DELAY_MS));
-        } else {
-            st_stream.timer_wait_cond_.wait_for(lck,
-                std::chrono::milliseconds(ST_DEFERRED_STOP_DELAY_MS));
-        }
-
-        if (!st_stream.timer_stop_waiting_ && !st_stream.exit_timer_thread_) {
-            st_stream.timer_mutex_.unlock();
-            st_stream.InternalStopRecognition();
-            st_stream.timer_mutex_.lock();
-        }
-    }
-    PAL_DBG(LOG_TAG, "Exit");
-}
-
 void StreamSoundTrigger::PostDelayedStop() {
+    uint32_t delay_ms = ST_DEFERRED_STOP_DELAY_MS;
+    uint32_t gen = 0;
+
     PAL_VERBOSE(LOG_TAG, "Post Delayed Stop for %p", this);
     pending_stop_ = true;
     std::lock_guard<std::mutex> lck(timer_mutex_);
-    timer_stop_waiting_ = false;
-    timer_start_cond_.notify_one();
+    if (delayed_stop_timer_)
+        return;
+
+    if (GetCurrentStateId() == ST_STATE_BUFFERING && !second_stage_processing_)
+        delay_ms = ST_LAB_DEFERRED_STOP_DELAY_MS;
+
+    gen = ++stop_timer_gen_;
+    delayed_stop_timer_ = PalReactor::getInstance()->postDelayed(delay_ms,
+        [this, gen]() {
+            {
+                std::lock_guard<std::mutex> lck(timer_mutex_);
+                if (gen == stop_timer_gen_)
+                    delayed_stop_timer_ = 0;
+            }
+            InternalStopRecognition();
+            std::lock_guard<std::mutex> lck(timer_mutex_);
+            stop_timers_.erase(gen);
+        }, true);
+    if (!delayed_stop_timer_) {
+        PAL_ERR(LOG_TAG, "Failed to schedule delayed stop for %p", this);
+    } else {
+        stop_timers_[gen] = delayed_stop_timer_;
+    }
 }
 
 void StreamSoundTrigger::CancelDelayedStop() {
     PAL_VERBOSE(LOG_TAG, "Cancel Delayed stop for %p", this);
     pending_stop_ = false;
     std::lock_guard<std::mutex> lck(timer_mutex_);
-    timer_stop_waiting_ = true;
-    timer_wait_cond_.notify_one();
+    /*
+     * Don't wait for a callback already running, it blocks on mStreamMutex
+     * held by the caller and bails out on pending_stop_ once it gets it.
+     */
+    if (delayed_stop_timer_) {
+        // a running callback stays tracked until it has returned
+        if (PalReactor::getInstance()->cancel(delayed_stop_timer_))
+            stop_timers_.erase(stop_timer_gen_);
+        delayed_stop_timer_ = 0;
+    }
 }
 
 std::shared_ptr<SoundTriggerEngine> StreamSoundTrigger::HandleEngineLoad(
@@ -1251,9 +1257,15 @@ int32_t StreamSoundTrigger::LoadSoundModel(
     sound_model_data_t *sm_data = nullptr;
     sound_model_list_t model_list;
     sound_model_config_t sound_model_config;
+    std::shared_ptr<SoundModelCache> sm_cache = SoundModelCache::getInstance();
+    SoundModelCache::Key sm_key;
 
     PAL_DBG(LOG_TAG, "Enter");
 
+    // a parked interface refers to sm_config_, which a new client model replaces
+    if (sound_model != sm_config_)
+        sm_cache->Drop(this);
+
     status = UpdateSoundModel(sound_model);
     if (status) {
         PAL_ERR(LOG_TAG, "Failed to update sound model, status %d", status);
@@ -1262,20 +1274,25 @@ int32_t StreamSoundTrigger::LoadSoundModel(
 
     // init Voice UI interface with sound model
     model_type_ = sm_cfg_->GetVUIModuleType();
-    sound_model_config.sound_model = sm_config_;
-    sound_model_config.module_type = model_type_;
-    sound_model_config.is_model_merge_enabled = sm_cfg_->GetMergeFirstStageSoundModels();
-    sound_model_config.supported_engine_count = sm_cfg_->GetSupportedEngineCount();
-    sound_model_config.intf_plugin_lib = sm_cfg_->GetVUIIntfPluginLib();
-    param_model.stream = (void *)this;
-    param_model.data = (void *)&sound_model_config;
-    status = GetVUIInterface(&vui_intf_handle_, &param_model);
-    if (status || !vui_intf_handle_.interface) {
-        PAL_ERR(LOG_TAG, "Failed to init voice ui interface, status %d", status);
-        goto error_exit;
+    SoundModelCache::MakeKey(sm_config_, &sm_key);
+    if (!sm_cache->Take(this, sm_key, &vui_intf_handle_)) {
+        sound_model_config.sound_model = sm_config_;
+        sound_model_config.module_type = model_type_;
+        sound_model_config.is_model_merge_enabled =
+            sm_cfg_->GetMergeFirstStageSoundModels();
+        sound_model_config.supported_engine_count = sm_cfg_->GetSupportedEngineCount();
+        sound_model_config.intf_plugin_lib = sm_cfg_->GetVUIIntfPluginLib();
+        param_model.stream = (void *)this;
+        param_model.data = (void *)&sound_model_config;
+        status = GetVUIInterface(&vui_intf_handle_, &param_model);
+        if (status || !vui_intf_handle_.interface) {
+            PAL_ERR(LOG_TAG, "Failed to init voice ui interface, status %d", status);
+            goto error_exit;
+        }
     }
 
     vui_intf_ = vui_intf_handle_.interface;
+    param_model.stream = (void *)this;
     param_model.data = (void *)&model_type_;
     status = vui_intf_->GetParameter(PARAM_FSTAGE_SOUND_MODEL_TYPE, &param_model);
     if (status) {
@@ -1345,6 +1362,7 @@ exit:
 
 int32_t StreamSoundTrigger::UnloadSoundModel() {
     int32_t status = 0;
+    SoundModelCache::Key sm_key;
 
     PAL_DBG(LOG_TAG, "Enter");
 
@@ -1377,12 +1395,22 @@ int32_t StreamSoundTrigger::UnloadSoundModel() {
         gsl_engine_ = nullptr;
     }
 
-    if (vui_intf_) {
-        vui_intf_->DetachStream(this);
+    /*
+     * Park the interface with the model parsed into it, a reload of the
+     * same model (SSR, concurrency) takes it back from the cache.
+     */
+    if (vui_intf_ && sm_config_) {
+        SoundModelCache::MakeKey(sm_config_, &sm_key);
+        SoundModelCache::getInstance()->Park(this, sm_key, &vui_intf_handle_);
         vui_intf_ = nullptr;
+    } else {
+        if (vui_intf_) {
+            vui_intf_->DetachStream(this);
+            vui_intf_ = nullptr;
+        }
+        ReleaseVUIInterface(&vui_intf_handle_);
+        vui_intf_handle_.interface = nullptr;
     }
-    ReleaseVUIInterface(&vui_intf_handle_);
-    vui_intf_handle_.interface = nullptr;
 
     if (reader_) {
         delete reader_;
@@ -41,6 +41,11 @@
 #include "us_detect_api.h"
 #include <unistd.h>
 
+/* Currently configured value is 20ms which allows 3 to 4 process call
+ * to handle a gain change at ADSP side.
+ * Increase or decrease this delay based on requirements */
+#define US_GAIN_RAMP_US (20*1000)
+
 StreamUltraSound::StreamUltraSound(const struct pal_stream_attributes *sattr __unused, struct pal_device *dattr __unused,
                     const uint32_t no_of_devices __unused, const struct modifier_kv *modifiers __unused,
                     const uint32_t no_of_modifiers __unused, const std::shared_ptr<ResourceManager> rm):
@@ -117,6 +122,8 @@ int32_t StreamUltraSound::stop()
     PAL_DBG(LOG_TAG, "Enter");
 
     if (rm->IsCustomGainEnabledForUPD()) {
+        bool rampDown = false;
+
         mStreamMutex.lock();
         if (currentState == STREAM_STARTED || currentState == STREAM_PAUSED) {
 
@@ -124,12 +131,11 @@ int32_t StreamUltraSound::stop()
             if (0 != status) {
                 PAL_ERR(LOG_TAG, "Ultrasound set gain failed, status = %d", status);
             }
-            /* Currently configured value is 20ms which allows 3 to 4 process call
-             * to handle this value at ADSP side.
-             * Increase or decrease this dealy based on requirements */
-            usleep(20000);
+            rampDown = true;
         }
         mStreamMutex.unlock();
+        if (rampDown)
+            session->waitForDspProcessed(US_GAIN_RAMP_US);
     }
 
     status = StreamCommon::stop();
@@ -257,10 +263,13 @@ int32_t StreamUltraSound::setUltraSoundGain_l(pal_ultrasound_gain_t new_gain)
             gain = mute;
             PAL_DBG(LOG_TAG, "Ultrasound gain(%d), configured successfully", gain);
 
-            /* Currently configured value is 20ms which allows 3 to 4 process call
-             * to handle this value at ADSP side.
-             * Increase or decrease this dealy based on requirements */
-            usleep(20000);
+            mStreamMutex.unlock();
+            session->waitForDspProcessed(US_GAIN_RAMP_US);
+            mStreamMutex.lock();
+            if (currentState != STREAM_STARTED && currentState != STREAM_PAUSED) {
+                PAL_DBG(LOG_TAG, "stream stopped during ramp down, skip gain(%d)", new_gain);
+                return status;
+            }
         }
 
         status = session->setParameters(this, TAG_ULTRASOUND_GAIN, PAL_PARAM_ID_ULTRASOUND_SET_GAIN, &new_gain);
@@ -100,6 +100,7 @@ public:
     static void process_haptics_info(struct haptics_xml_data *data, const XML_Char *tag_name);
     void getTouchHapticsEffectConfiguration(int effect_id, bool isCompose, haptics_wave_designer_config_t **HConfig);
     int getRingtoneHapticsEffectConfiguration() {return ringtone_haptics_wave_design_mode;}
+    int getTouchHapticsEffectCount(bool isCompose);
     static int init();
     static std::shared_ptr<AudioHapticsInterface> GetInstance();
 private:
@@ -14,14 +14,19 @@
 #include "Stream.h"
 #include <inttypes.h>
 
-int palStateQueueBuilder(pal_state_queue &que, Stream *s, pal_state_queue_state state, int32_t error);
 int palStateEnqueue(Stream *s, pal_state_queue_state state, int32_t error);
 int palStateEnqueue(Stream *s, pal_state_queue_state state, int32_t error, union pal_mlog_str_info str_info);
 pal_mlog_acdstr_info palStateACDStreamBuilder(Stream *s);
+/*
+ * moves queued state events to PAL_STATE_Q, call before dumping the memlogger;
+ * inSignal skips the flush if the collector is busy and logs device ids only
+ */
+void palStateFlush(bool inSignal);
 void kpiEnqueue(const char name[], bool isEnter);
 #else
 #define palStateEnqueue(...) (0)
 #define kpiEnqueue(...) (0)
+#define palStateFlush(...) do {} while (0)
 #endif
 
 #endif
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#define PAL_BINLOG_MAX_ARGS 12
+#define PAL_BINLOG_STR_BYTES 64
+#define PAL_BINLOG_RING_SLOTS 256
+#define PAL_BINLOG_MAX_RINGS 32
+
+/**
+ * Binary backend for PAL_INFO/PAL_DBG/PAL_VERBOSE, selected at runtime with
+ * the PAL_LOG_BINARY bit of pal_log_lvl.
+ *
+ * A log call stores the format string pointer, call site and raw arguments
+ * (strings copied, truncated to PAL_BINLOG_STR_BYTES in total) into a ring
+ * owned by the calling thread, without taking a lock or formatting. Rings
+ * are formatted only when dump() is called. Threads which cannot get a
+ * ring, because PAL_BINLOG_MAX_RINGS threads are already logging, see
+ * ready() return false and keep logging to logd.
+ **/
+class PalBinLog final {
+  public:
+    enum ArgType : uint8_t {
+        ARG_INT,
+        ARG_UINT,
+        ARG_DOUBLE,
+        ARG_PTR,
+        ARG_STR,
+    };
+
+    struct Record {
+        uint64_t tsNs;
+        const char *tag;
+        const char *fmt;
+        const char *func;
+        int32_t tid;
+        uint16_t line;
+        uint8_t level;
+        uint8_t nargs;
+        uint8_t strUsed;
+        uint8_t types[PAL_BINLOG_MAX_ARGS];
+        uint64_t args[PAL_BINLOG_MAX_ARGS];
+        char str[PAL_BINLOG_STR_BYTES];
+    };
+
+    // false when the calling thread has no ring, log to logd instead
+    static bool ready() { return threadRing() != nullptr; }
+
+    template <typename... Args>
+    static void record(uint32_t level, const char *tag, const char *func, int line,
+                       const char *fmt, Args... args)
+    {
+        static_assert(sizeof...(Args) <= PAL_BINLOG_MAX_ARGS,
+                      "too many arguments for the binary log");
+        Slot *slot = beginSlot();
+
+        if (!slot)
+            return;
+
+        fillHeader(&slot->rec, level, tag, func, line, fmt);
+        int expand[] = {0, (pack(&slot->rec, args), 0)...};
+        (void)expand;
+        endSlot(slot);
+    }
+
+    /*
+     * Formats all captured records, oldest first, into a new file
+     * pal_binlog_<time>.txt in dir. Returns the number of records.
+     */
+    static int dump(const char *dir);
+    // formats one record, returns the length of the formatted message
+    static size_t format(const Record *rec, char *buf, size_t size);
+
+  private:
+    struct Slot {
+        std::atomic<uint32_t> seq;
+        Record rec;
+    };
+
+    struct Ring;
+    struct ThreadRing;
+
+    static Ring *threadRing();
+    static Slot *beginSlot();
+    static void endSlot(Slot *slot);
+    static void fillHeader(Record *rec, uint32_t level, const char *tag,
+                           const char *func, int line, const char *fmt);
+    static void putArg(Record *rec, ArgType type, uint64_t val);
+    static void putStr(Record *rec, const char *s);
+
+    template <typename T>
+    static typename std::enable_if<std::is_integral<T>::value>::type
+    pack(Record *rec, T val)
+    {
+        if (std::is_signed<T>::value)
+            putArg(rec, ARG_INT, (uint64_t)(int64_t)val);
+        else
+            putArg(rec, ARG_UINT, (uint64_t)val);
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_enum<T>::value>::type
+    pack(Record *rec, T val)
+    {
+        pack(rec, (typename std::underlying_type<T>::type)val);
+    }
+
+    template <typename T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    pack(Record *rec, T val)
+    {
+        double d = (double)val;
+        uint64_t bits = 0;
+
+        memcpy(&bits, &d, sizeof(bits));
+        putArg(rec, ARG_DOUBLE, bits);
+    }
+
+    template <typename T>
+    static void pack(Record *rec, T *ptr)
+    {
+        putArg(rec, ARG_PTR, (uint64_t)(uintptr_t)ptr);
+    }
+
+    static void pack(Record *rec, const char *s) { putStr(rec, s); }
+    static void pack(Record *rec, char *s) { putStr(rec, s); }
+    static void pack(Record *rec, std::nullptr_t) { putArg(rec, ARG_PTR, 0); }
+
+    static std::mutex sRingsMutex;
+    static std::vector<Ring *> sRings;
+};
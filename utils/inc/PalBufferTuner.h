@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <mutex>
+
+/**
+ * Adaptive period size of PCM sessions, enabled per stream type with the
+ * adaptive_buffer nodes of the resourcemanager XML:
+ *
+ *   <adaptive_buffer stream="PAL_STREAM_VOIP_RX" min_period_ms="5"
+ *                    max_period_ms="20"/>
+ *
+ * The session reports every read or write with onTransfer(), which
+ * measures the interval between transfers against the audio they carried.
+ * stop() closes the measurement and picks the period for the next pcm
+ * open, the only point where the period can change:
+ *  - a gap longer than the buffered audio (an xrun) or jitter above half
+ *    a period doubles the period,
+ *  - a client which transfers several periods per wakeup moves the period
+ *    up to its transfer size, which saves DSP wakeups without adding
+ *    latency the client does not already have,
+ *  - a clean run with smaller transfers halves the period again.
+ * The period stays within the configured bounds, in whole milliseconds.
+ **/
+class PalBufferTuner final {
+  public:
+    // parses the attributes of one adaptive_buffer node
+    static int parse(const char **attr);
+
+    /*
+     * Starts a measurement and returns the period to open the pcm with,
+     * requestedFrames when adaptive sizing is not enabled for streamType.
+     */
+    size_t start(uint32_t streamType, uint32_t rate, size_t requestedFrames,
+                 size_t periodCount);
+    void onTransfer(size_t frames);
+    // picks the period for the next start()
+    void stop();
+
+  private:
+    struct Bounds {
+        uint32_t minMs;
+        uint32_t maxMs;
+    };
+
+    size_t clampFrames(size_t frames) const;
+
+    static std::mutex sMutex;
+    static std::map<uint32_t, Bounds> sBounds;
+
+    std::mutex mMutex;
+    bool mActive = false;
+    Bounds mBounds = {};
+    uint32_t mRate = 0;
+    size_t mRequested = 0;
+    size_t mCount = 0;
+    size_t mPeriod = 0;
+    size_t mNextPeriod = 0;
+    uint32_t mCleanRuns = 0;
+    // measurement since start()
+    int64_t mStartUs = 0;
+    int64_t mLastUs = 0;
+    size_t mLastFrames = 0;
+    uint32_t mTransfers = 0;
+    uint32_t mXruns = 0;
+    uint64_t mFrames = 0;
+    int64_t mJitterUs = 0;
+};
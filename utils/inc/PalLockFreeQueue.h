@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+/*
+ * Bounded multi-producer multi-consumer queue without locks, based on
+ * per-cell sequence numbers. push() never blocks, it fails when the queue
+ * is full. Used by the memlogger state events and the AIDL callback
+ * dispatcher.
+ */
+template <typename T, size_t N>
+class PalLockFreeQueue {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    Cell mCells[N];
+    alignas(64) std::atomic<size_t> mEnqueuePos;
+    alignas(64) std::atomic<size_t> mDequeuePos;
+
+  public:
+    PalLockFreeQueue() : mEnqueuePos(0), mDequeuePos(0) {
+        for (size_t i = 0; i < N; i++) mCells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(T &&item) {
+        Cell *cell = nullptr;
+        size_t pos = mEnqueuePos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            cell = &mCells[pos & (N - 1)];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0) {
+                if (mEnqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = mEnqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(item);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &item) {
+        Cell *cell = nullptr;
+        size_t pos = mDequeuePos.load(std::memory_order_relaxed);
+
+        for (;;) {
+            cell = &mCells[pos & (N - 1)];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (mDequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = mDequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        item = std::move(cell->data);
+        cell->data = T();
+        cell->seq.store(pos + N, std::memory_order_release);
+        return true;
+    }
+
+    // approximate, for statistics only
+    size_t depth() const {
+        size_t enq = mEnqueuePos.load(std::memory_order_relaxed);
+        size_t deq = mDequeuePos.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+    static constexpr size_t capacity() { return N; }
+};
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+/**
+ * Shared event loop for PAL services which only need to wake up on a fd
+ * event or a timeout.
+ *
+ * One epoll thread waits on an eventfd (task wakeup), a timerfd armed to the
+ * earliest pending timer and the registered fds. Handlers never run on the
+ * epoll thread, they are dispatched to a small worker pool.
+ * Fds are registered EPOLLONESHOT and re-armed once their handler returns,
+ * so a handler never runs concurrently with itself.
+ *
+ * Handlers on the worker pool must not take stream, session or RM locks,
+ * the sound card monitor relies on them to report SSR. Timers which stop,
+ * unload or switch streams are posted with blocking set instead and run one
+ * at a time on a thread of their own.
+ **/
+class PalReactor final {
+  public:
+    typedef uint64_t TimerId;
+    using Task = std::function<void()>;
+    using FdHandler = std::function<void(uint32_t events)>;
+
+    static std::shared_ptr<PalReactor> getInstance();
+
+    // events are EPOLL* flags, EPOLLONESHOT is added internally
+    int addFd(int fd, uint32_t events, FdHandler handler);
+    // waits for a running handler of fd unless called from a worker
+    int removeFd(int fd);
+
+    int post(Task task);
+    // returns 0 on failure
+    TimerId postDelayed(uint32_t delayMs, Task task, bool blocking = false);
+    // true if the timer was still pending and will not run
+    bool cancel(TimerId id);
+    // as cancel(), additionally waits for a running callback to return
+    bool cancelSync(TimerId id);
+
+    bool isWorkerThread();
+
+    PalReactor();
+    ~PalReactor();
+
+  private:
+    PalReactor(const PalReactor&) = delete;
+    PalReactor& operator=(const PalReactor&) = delete;
+
+    struct FdEntry {
+        FdHandler handler;
+        uint32_t events;
+        bool running;
+    };
+
+    struct Timer {
+        std::chrono::steady_clock::time_point deadline;
+        Task task;
+        bool blocking;
+    };
+
+    void loop();
+    void workerLoop(bool blocking);
+    void wakeup();
+    // Below functions need to be called with mMutex held
+    void armTimerFd_l();
+    void expireTimers_l();
+    void dispatchFd_l(int fd, uint32_t events);
+    void enqueue_l(Task task, bool blocking = false);
+
+    static std::shared_ptr<PalReactor> sInstance;
+
+    int mEpollFd;
+    int mEventFd;
+    int mTimerFd;
+    bool mExit;
+    std::thread mLoopThread;
+    std::vector<std::thread> mWorkers;
+    std::thread mBlockingWorker;
+    std::set<std::thread::id> mWorkerIds;
+
+    std::mutex mMutex;
+    std::condition_variable mTaskCV;
+    std::condition_variable mIdleCV;
+    std::condition_variable mBlockingCV;
+    std::deque<Task> mTasks;
+    std::deque<Task> mBlockingTasks;
+    std::map<int, FdEntry> mFds;
+    TimerId mNextTimerId;
+    std::map<TimerId, Timer> mTimers;
+    std::multimap<std::chrono::steady_clock::time_point, TimerId> mTimerQueue;
+    std::set<TimerId> mRunningTimers;
+};
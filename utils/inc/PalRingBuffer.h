@@ -42,6 +42,7 @@
 #include <iostream>
 #include <string.h>
 #include "Stream.h"
+#include "PalReactor.h"
 
 #ifndef PALRINGBUFFER_H_
 #define PALRINGBUFFER_H_
@@ -67,6 +68,45 @@ struct kwdConfig {
 
 class PalRingBuffer;
 
+/*
+ * Storage of the sound trigger ring buffers. A ring holds storage only
+ * from its first write after a detection until its next reset. Released
+ * blocks are cached for the next detection, up to PAL_RING_POOL_MAX_IDLE_BYTES
+ * in total, and freed once unused for PAL_RING_POOL_IDLE_TIMEOUT_MS.
+ */
+#define PAL_RING_POOL_MAX_IDLE_BYTES (512 * 1024)
+#define PAL_RING_POOL_IDLE_TIMEOUT_MS 5000
+
+class PalRingBufferPool {
+ public:
+    struct Stats {
+        size_t liveBytes;   // held by rings
+        size_t peakBytes;
+        size_t idleBytes;   // cached in the pool
+        uint32_t allocs;
+        uint32_t reuses;
+    };
+
+    static char* acquire(size_t size, size_t *capacity);
+    static void release(char *block, size_t capacity);
+    static Stats getStats();
+    static void dump();
+
+ private:
+    struct IdleBlock {
+        size_t capacity;
+        char *block;
+        int64_t releasedMs;
+    };
+
+    static void trim();
+
+    static std::mutex mutex_;
+    static std::vector<IdleBlock> idle_;
+    static Stats stats_;
+    static PalReactor::TimerId trimTimer_;
+};
+
 class PalRingBufferReader {
  public:
      PalRingBufferReader(PalRingBuffer *buffer)
@@ -105,13 +145,14 @@ class PalRingBufferReader {
 class PalRingBuffer {
  public:
     explicit PalRingBuffer(size_t bufferSize)
-        : buffer_((char*)(new char[bufferSize])),
+        : buffer_(nullptr),
+          capacity_(0),
           writeOffset_(0),
           bufferEnd_(bufferSize) {}
 
     ~PalRingBuffer() {
         if (buffer_)
-            delete buffer_;
+            PalRingBufferPool::release(buffer_, capacity_);
 
         for (int i = 0; i < readers_.size(); i++)
             delete readers_[i];
@@ -135,11 +176,13 @@ class PalRingBuffer {
  protected:
     std::mutex mutex_;
     char* buffer_;
+    size_t capacity_;
     std::unordered_map<Stream*, struct kwdConfig> kwCfg_;
     size_t writeOffset_;
     size_t bufferEnd_;
     std::vector<PalRingBufferReader*> readers_;
     void updateUnReadSize(size_t writtenSize);
+    void releaseStorage_l();
     friend class PalRingBufferReader;
 };
 #endif
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * Scheduling policy of named PAL threads, read from the thread_policy nodes
+ * of the resourcemanager XML:
+ *
+ *   <thread_policy name="pal_st_buffer" sched="SCHED_FIFO" priority="2"
+ *                  nice="0" cpus="4-7" cpuset="audio-app"/>
+ *
+ * A thread calls apply() with its name first thing in its loop, which names
+ * it and applies the configured policy, if any. Threads without a policy
+ * keep the default scheduling. Attributes which are not given are not
+ * changed.
+ **/
+class PalThreadPolicy final {
+  public:
+    // thread names, at most 15 characters
+    static constexpr const char *ST_BUFFER = "pal_st_buffer";
+    static constexpr const char *ST_EVENT = "pal_st_event";
+    static constexpr const char *ACD_EVENT = "pal_acd_event";
+    static constexpr const char *ASR_EVENT = "pal_asr_event";
+    static constexpr const char *OFFLOAD = "pal_offload";
+    static constexpr const char *MIXER_EVENT = "pal_mixer_evt";
+    static constexpr const char *IPC_CALLBACK = "pal_ipc_cb";
+
+    // parses the attributes of one thread_policy node
+    static int parse(const char **attr);
+    static int apply(const char *name);
+    // logs the configured policies and the threads they were applied to
+    static void dump();
+
+  private:
+    struct Policy {
+        int sched = -1;
+        int priority = 0;
+        bool setNice = false;
+        int nice = 0;
+        uint64_t cpus = 0;
+        std::string cpuset;
+    };
+
+    struct Applied {
+        pid_t tid;
+        int status;
+    };
+
+    static int parseCpus(const char *str, uint64_t *cpus);
+
+    static std::mutex sMutex;
+    static std::map<std::string, Policy> sPolicies;
+    // last thread of each name which applied a policy
+    static std::map<std::string, Applied> sApplied;
+};
@@ -4,18 +4,30 @@
  */
 #pragma once
 
+#include <stdint.h>
+#include <chrono>
+#include <map>
 #include <mutex>
+#include <string>
+#include <tuple>
 #include <vector>
 
 struct PerfLockConfig {
     bool usePerfLock = false;
     std::string libraryName;
     std::vector<int> perfLockOpts;
+    // 0 boosts every call, otherwise the latency budget of a call in us
+    uint32_t budgetUs = 0;
 };
 
 /**
  * A Scoped object for real perf lock.
  * Only one among the existing PerfLock instances possibly acquires real perf lock.
+ *
+ * With a latency budget configured, the lock is not taken in the constructor.
+ * setStreamContext() looks up the learned cost of the caller for that stream
+ * type and device and only boosts when the prediction exceeds the budget.
+ * The cost of each scope is fed back on destruction.
  **/
 class PerfLock final {
   public:
@@ -24,6 +36,8 @@ class PerfLock final {
     ~PerfLock();
     // Read config from resource_manager and set configs
     static void setPerfLockOpt(const PerfLockConfig & config);
+    // no-op unless a budget is configured
+    void setStreamContext(uint32_t streamType, uint32_t deviceId);
 
   private:
     // disable copy
@@ -34,6 +48,18 @@ class PerfLock final {
     PerfLock(PerfLock&& other) = delete;
     PerfLock& operator=(PerfLock&& other) = delete;
 
+    using CostKey = std::tuple<std::string, uint32_t, uint32_t>;
+
+    struct CostStats {
+        // moving averages of the scope duration in us, 0 until sampled
+        uint32_t unboostedUs = 0;
+        uint32_t boostedUs = 0;
+        uint32_t calls = 0;
+        uint32_t boosted = 0;
+        // boosted calls which came in under the unboosted average
+        uint32_t helped = 0;
+    };
+
     // function mapping for dlsym
     using AcquirePerfLock = int (*)(int, int, int*, int);
     using ReleasePerfLock = int (*)(int);
@@ -49,11 +75,20 @@ class PerfLock final {
     inline static int sHandle{0};
     inline static bool usePerfLock;
     inline static std::string sLibraryName;
+    inline static uint32_t sBudgetUs = 0;
+    inline static std::map<CostKey, CostStats> sCosts;
 
     std::string mCaller;
+    std::chrono::steady_clock::time_point mStart;
+    bool mHeld = false;
+    bool mTracked = false;
+    bool mBoosted = false;
+    CostKey mKey;
     static bool init();
 
     // Below functions needs to be called with sMutex lock held
     void acquire_l();
     void release_l();
+    bool shouldBoost_l(CostStats &stats);
+    void recordCost_l(uint32_t costUs);
 };
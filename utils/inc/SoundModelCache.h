@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include "PalDefs.h"
+#include "PalReactor.h"
+#include "VoiceUIInterface.h"
+
+/**
+ * Keeps the parsed sound model of an unloaded sound trigger stream.
+ *
+ * The voice UI interface parses the client model when it is created and
+ * keeps the parsed sub-models registered for the stream. Instead of
+ * releasing the interface on unload, a stream parks it here; the reload
+ * after SSR or an internal stop/start takes it back and skips the parse.
+ * Entries are matched on the owning stream and the client model: vendor
+ * UUID, sizes and a 64-bit FNV-1a hash over the whole model, so a model
+ * re-enrolled with the same size and header does not hit. A parked
+ * interface is released when it is not taken back within
+ * SM_CACHE_IDLE_TIMEOUT_MS or when its stream goes away.
+ *
+ * The parsed sub-models stay owned by the voice UI interface the stream
+ * attached to, so they are not shared across streams.
+ **/
+class SoundModelCache final {
+  public:
+    struct Key {
+        struct st_uuid vendorUuid;
+        uint32_t type;
+        uint32_t dataSize;
+        uint32_t dataOffset;
+        uint64_t hash;
+    };
+
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint32_t entries;
+        size_t residentBytes;
+    };
+
+    static std::shared_ptr<SoundModelCache> getInstance();
+    static void MakeKey(const struct pal_st_sound_model *model, Key *key);
+
+    // Hands the interface parked by owner back if it matches key
+    bool Take(void *owner, const Key &key, struct vui_intf_t *intf);
+    // Takes over intf, which must have owner's model registered
+    void Park(void *owner, const Key &key, struct vui_intf_t *intf);
+    // Releases the interface parked by owner, if any
+    void Drop(void *owner);
+    void GetStats(Stats *stats);
+
+    SoundModelCache();
+    ~SoundModelCache();
+
+  private:
+    SoundModelCache(const SoundModelCache&) = delete;
+    SoundModelCache& operator=(const SoundModelCache&) = delete;
+
+    struct Entry {
+        Key key;
+        struct vui_intf_t intf;
+        int64_t parkedMs;
+    };
+
+    void expire();
+    // Below functions need to be called with mMutex held
+    void releaseEntry_l(void *owner, Entry &entry);
+    void logStats_l(const char *op);
+
+    static std::shared_ptr<SoundModelCache> sInstance;
+
+    std::mutex mMutex;
+    std::map<void *, Entry> mEntries;
+    PalReactor::TimerId mExpiryTimer;
+    size_t mResidentBytes;
+    uint64_t mHits;
+    uint64_t mMisses;
+};
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct mixer;
+struct mixer_ctl;
+
+/**
+ * Temperature and calibration file access shared by speaker and haptics
+ * protection.
+ *
+ * Temperature controls are resolved once per mixer and all channels are read
+ * in one call. The resolved controls are dropped when RM closes the mixer or
+ * the sound card changes state, a missing control is looked up again on the
+ * next read. Calibration files are kept in memory and only read again when
+ * the file changes on disk (inode, size or mtime) or after invalidate(), so
+ * getParameter() queries and graph setup do not touch the file system and
+ * never wait for the calibration thread.
+ **/
+class ThermalCalService final {
+  public:
+    typedef std::shared_ptr<const std::vector<uint8_t>> CalData;
+    // candidate control names of one channel, the first existing one is used
+    typedef std::vector<std::string> TempCtrlNames;
+
+    static std::shared_ptr<ThermalCalService> getInstance();
+
+    /*
+     * Fills temps[i] with the value of channel i, -EINVAL for a channel
+     * without any control. Returns the number of channels read.
+     */
+    int readTemperatures(struct mixer *mixer,
+                         const std::vector<TempCtrlNames> &channels, int *temps);
+    // Drops the controls resolved on mixer, on all mixers if it is nullptr
+    void invalidateMixer(struct mixer *mixer);
+
+    // Returns the file contents, nullptr if the file does not exist
+    CalData getCalData(const std::string &path);
+    // To be called after writing a calibration file
+    void invalidate(const std::string &path);
+
+    // fread() like sequential access to a CalData snapshot
+    static bool readCal(const CalData &data, size_t *offset, void *dst, size_t size);
+
+    ThermalCalService();
+    ~ThermalCalService();
+
+  private:
+    ThermalCalService(const ThermalCalService&) = delete;
+    ThermalCalService& operator=(const ThermalCalService&) = delete;
+
+    struct CalEntry {
+        CalData data;
+        ino_t ino;
+        off_t size;
+        struct timespec mtime;
+    };
+
+    struct mixer_ctl *resolveCtrl_l(struct mixer *mixer, const TempCtrlNames &names);
+
+    static std::shared_ptr<ThermalCalService> sInstance;
+
+    std::mutex mTempMutex;
+    std::map<std::pair<struct mixer *, std::string>, struct mixer_ctl *> mTempCtrls;
+
+    std::mutex mCalMutex;
+    std::map<std::string, CalEntry> mCalFiles;
+};
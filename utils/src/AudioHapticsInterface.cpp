@@ -495,8 +495,18 @@ void AudioHapticsInterface::process_haptics_info(struct haptics_xml_data *data,
     PAL_ERR(LOG_TAG, "%s \n", data->data_buf);
 }
 
+int AudioHapticsInterface::getTouchHapticsEffectCount(bool isCompose)
+{
+    return isCompose ? compose_haptics_info.size() : predefined_haptics_info.size();
+}
+
 void AudioHapticsInterface::getTouchHapticsEffectConfiguration(int effect_id, bool isCompose, haptics_wave_designer_config_t **HConfig)
 {
+    if (effect_id >= getTouchHapticsEffectCount(isCompose)) {
+        PAL_ERR(LOG_TAG, "invalid effect id %d, isCompose %d", effect_id, isCompose);
+        return;
+    }
+
     if (effect_id >= 0) {
         if (*HConfig == NULL) {
             if (isCompose) {
@@ -511,7 +521,7 @@ void AudioHapticsInterface::getTouchHapticsEffectConfiguration(int effect_id, bo
                         sizeof(predefined_haptics_info[effect_id]));
             }
         }
-    } else {
+    } else if (!oneshot_haptics_info.empty()) {
         if (*HConfig == NULL) {
             *HConfig = (haptics_wave_designer_config_t *) calloc(1, sizeof(oneshot_haptics_info[0]));
             if (*HConfig)
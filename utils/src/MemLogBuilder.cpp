@@ -5,113 +5,193 @@
 
 #include "MemLogBuilder.h"
 #include "Device.h"
+#include "PalReactor.h"
+#include "PalLockFreeQueue.h"
 #include <hwbinder/IPCThreadState.h>
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 #define LOG_TAG "PAL: memLoggerBuilder"
 
-int palStateQueueBuilder(pal_state_queue &que, Stream *s, pal_state_queue_state state, int32_t error)
+#define PAL_STATE_SHARDS 4
+#define PAL_STATE_SHARD_SLOTS 64
+#define PAL_STATE_DRAIN_DELAY_MS 50
+
+/*
+ * State change recorded on the caller's path. The devices are the ones
+ * the stream ran on at that point, their attributes are read later by the
+ * collector, which may wait on a device lock. s is only used as the key of
+ * the per-stream device attributes, the stream may be gone by then.
+ */
+struct PalStateEvent {
+    struct pal_state_queue que;
+    Stream *s;
+    std::shared_ptr<Device> devices[STATE_DEVICE_MAX_SIZE];
+};
+
+/*
+ * Producers are spread over the shards by cpu, so they rarely contend on
+ * the same cache line. Only the collector pops, with stateDrainMutex held.
+ */
+static PalLockFreeQueue<PalStateEvent, PAL_STATE_SHARD_SLOTS> stateShards[PAL_STATE_SHARDS];
+static std::atomic<bool> stateDrainPending(false);
+// events written straight to the memlogger because all shards were full
+static std::atomic<uint32_t> stateOverflows(0);
+// serializes the collector with palStateFlush
+static std::mutex stateDrainMutex;
+
+static void palStateDrain();
+
+static void palStateScheduleDrain()
 {
-    PAL_DBG(LOG_TAG, "Entered PAL State Queue Builder");
-    int ret = 0;
-    std::vector <std::shared_ptr<Device>> aDevices;
-    struct pal_stream_attributes sAttr;
-    struct pal_device strDevAttr;
-    pal_stream_type_t type;
+    if (stateDrainPending.exchange(true))
+        return;
 
-    if (!memLoggerIsQueueInitialized())
-    {
-        PAL_ERR(LOG_TAG, "queues failed to initialize");
-        goto exit;
-    }
+    // device attributes take the device locks, keep off the pool lane
+    if (!PalReactor::getInstance()->postDelayed(PAL_STATE_DRAIN_DELAY_MS,
+            []() { palStateDrain(); }, true))
+        stateDrainPending.store(false);
+}
 
-    ret = s->getAssociatedDevices(aDevices);
-    if(ret != 0)
-    {
-        PAL_ERR(LOG_TAG, "getStreamType failed with status = %d", ret);
-        goto exit;
-    }
+static void palStateEmit(PalStateEvent &ev, bool resolveDevices)
+{
+    struct pal_device strDevAttr;
+    int ret = 0;
 
-    ret = s->getStreamType(&type);
-    if(ret != 0)
-    {
-        PAL_ERR(LOG_TAG, "getStreamType failed with status = %d", ret);
-        goto exit;
+    for (int i = 0; i < STATE_DEVICE_MAX_SIZE && ev.devices[i]; i++) {
+        if (!resolveDevices) {
+            ev.que.device_attr[i].device = ev.devices[i]->getSndDeviceId();
+            continue;
+        }
+        ev.devices[i]->getDeviceAttributes(&strDevAttr, ev.s);
+        ev.que.device_attr[i].device = strDevAttr.id;
+        ev.que.device_attr[i].sample_rate = strDevAttr.config.sample_rate;
+        ev.que.device_attr[i].bit_width = strDevAttr.config.bit_width;
+        ev.que.device_attr[i].channels = strDevAttr.config.ch_info.channels;
     }
 
-    memset(&que, 0, sizeof(que));
-    s->getStreamAttributes(&sAttr);
-    que.stream_handle = (uint64_t) s;     // array to store queue element
-    que.stream_type = type;
-    que.direction = sAttr.direction;
-    que.state = state;
-    que.error = error;
-
-    PAL_DBG(LOG_TAG, "Stream handle = " "%" PRId64 "\n", s);
-
-    memset(que.device_attr, 0, sizeof(que.device_attr));
-
-    for(int i=0; i<aDevices.size(); i++)
-    {
-        if(i < STATE_DEVICE_MAX_SIZE)
-        {
-            aDevices[i]->getDeviceAttributes(&strDevAttr, s);
-            que.device_attr[i].device = strDevAttr.id;
-            que.device_attr[i].sample_rate = strDevAttr.config.sample_rate;
-            que.device_attr[i].bit_width = strDevAttr.config.bit_width;
-            que.device_attr[i].channels = strDevAttr.config.ch_info.channels;
+    ret = memLoggerEnqueue(PAL_STATE_Q, (void*) &ev.que);
+    if (ret != 0)
+        PAL_ERR(LOG_TAG, "memLoggerEnqueue failed with status = %d", ret);
+}
+
+/*
+ * Merges the shards by timestamp, each shard is in order already. Nothing
+ * is allocated, so this also serves the crash dump from signal context;
+ * devices hold no last reference here, they are kept by their classes.
+ */
+static void palStateDrain_l(bool resolveDevices)
+{
+    PalStateEvent heads[PAL_STATE_SHARDS];
+    bool valid[PAL_STATE_SHARDS];
+    uint32_t overflows = 0;
+    int next = 0;
+
+    // clear first, an event pushed from here on schedules another drain
+    stateDrainPending.store(false);
+    for (int i = 0; i < PAL_STATE_SHARDS; i++)
+        valid[i] = stateShards[i].pop(heads[i]);
+
+    for (;;) {
+        next = -1;
+        for (int i = 0; i < PAL_STATE_SHARDS; i++) {
+            if (valid[i] && (next < 0 ||
+                    heads[i].que.timestamp < heads[next].que.timestamp))
+                next = i;
         }
+        if (next < 0)
+            break;
+        palStateEmit(heads[next], resolveDevices);
+        valid[next] = stateShards[next].pop(heads[next]);
     }
 
-    que.timestamp = memLoggerFetchTimestamp();
+    overflows = stateOverflows.exchange(0);
+    if (overflows)
+        PAL_ERR(LOG_TAG, "%u state events logged out of order, queue full", overflows);
+}
 
-    PAL_DBG(LOG_TAG, "TIME IS:" "%" PRId64 "\n", que.timestamp);
+static void palStateDrain()
+{
+    std::lock_guard<std::mutex> lck(stateDrainMutex);
 
-exit:
-    return ret;
+    palStateDrain_l(true);
 }
 
-int palStateEnqueue(Stream *s, pal_state_queue_state state, int32_t error)
+static int palStateRecord(Stream *s, pal_state_queue_state state, int32_t error,
+                          const pal_mlog_str_info *strInfo)
 {
-    int ret = 0;
-    struct pal_state_queue que;
-    ret = palStateQueueBuilder(que, s, state, error);
-    if (ret != 0)
-    {
-        PAL_ERR(LOG_TAG, "palStateQueueBuilder failed with status = %d", ret);
-        goto exit;
+    std::vector <std::shared_ptr<Device>> aDevices;
+    PalStateEvent ev;
+    pal_stream_type_t type;
+    pal_stream_direction_t direction;
+    int cpu = sched_getcpu();
+
+    if (!memLoggerIsQueueInitialized()) {
+        PAL_ERR(LOG_TAG, "queues failed to initialize");
+        return 0;
     }
 
-    ret = memLoggerEnqueue(PAL_STATE_Q, (void*) &que);
-    if (ret != 0)
-    {
-        PAL_ERR(LOG_TAG, "memLoggerEnqueue failed with status = %d", ret);
+    memset(&ev.que, 0, sizeof(ev.que));
+    ev.s = s;
+    ev.que.stream_handle = (uint64_t)s;
+    ev.que.timestamp = memLoggerFetchTimestamp();
+    ev.que.state = state;
+    ev.que.error = error;
+    s->getStreamType(&type);
+    s->getStreamDirection(&direction);
+    ev.que.stream_type = type;
+    ev.que.direction = direction;
+    if (strInfo)
+        memcpy(&(ev.que.str_info), strInfo, sizeof(ev.que.str_info));
+
+    s->getAssociatedDevices(aDevices);
+    for (int i = 0; i < aDevices.size() && i < STATE_DEVICE_MAX_SIZE; i++)
+        ev.devices[i] = aDevices[i];
+
+    cpu = cpu < 0 ? 0 : cpu;
+    for (int i = 0; i < PAL_STATE_SHARDS; i++) {
+        if (stateShards[(cpu + i) % PAL_STATE_SHARDS].push(std::move(ev))) {
+            palStateScheduleDrain();
+            return 0;
+        }
     }
 
-exit:
-    return ret;
+    // never drop a state change, log it now without the device attributes
+    stateOverflows.fetch_add(1, std::memory_order_relaxed);
+    palStateEmit(ev, false);
+    palStateScheduleDrain();
+
+    return 0;
 }
 
+int palStateEnqueue(Stream *s, pal_state_queue_state state, int32_t error)
+{
+    return palStateRecord(s, state, error, nullptr);
+}
 
 int palStateEnqueue(Stream *s, pal_state_queue_state state, int32_t error, pal_mlog_str_info str_info)
 {
-    int ret = 0;
-    struct pal_state_queue que;
-    ret = palStateQueueBuilder(que, s, state, error);
-    if (ret != 0)
-    {
-        PAL_ERR(LOG_TAG, "palStateQueueBuilder failed with status = %d", ret);
-        goto exit;
-    }
-    memcpy(&(que.str_info), &str_info, sizeof(que.str_info));
+    return palStateRecord(s, state, error, &str_info);
+}
 
-    ret = memLoggerEnqueue(PAL_STATE_Q, (void*) &que);
-    if (ret != 0)
-    {
-        PAL_ERR(LOG_TAG, "memLoggerEnqueue failed with status = %d", ret);
+void palStateFlush(bool inSignal)
+{
+    std::unique_lock<std::mutex> lck(stateDrainMutex, std::defer_lock);
+
+    /*
+     * A crash on the collector itself would deadlock here, the dump goes
+     * on without the queued events then. Device locks are not taken either.
+     */
+    if (!inSignal) {
+        lck.lock();
+    } else if (!lck.try_lock()) {
+        PAL_ERR(LOG_TAG, "collector busy, queued state events not flushed");
+        return;
     }
 
-exit:
-    return ret;
+    palStateDrain_l(!inSignal);
 }
 
 void kpiEnqueue(const char name[], bool isEnter)
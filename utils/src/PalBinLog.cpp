@@ -0,0 +1,404 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#define LOG_TAG "PAL: PalBinLog"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <algorithm>
+#include <new>
+#include "PalCommon.h"
+#include "PalBinLog.h"
+
+struct PalBinLog::Ring {
+    Slot slots[PAL_BINLOG_RING_SLOTS];
+    // written by the owning thread only
+    uint32_t head;
+    int32_t tid;
+    std::atomic<bool> inUse;
+};
+
+/*
+ * Rings are never freed, a ring released by an exiting thread is handed
+ * to the next thread which starts logging, so its records stay readable
+ * until they are overwritten.
+ */
+struct PalBinLog::ThreadRing {
+    Ring *ring = nullptr;
+    bool failed = false;
+
+    ~ThreadRing() {
+        if (ring)
+            ring->inUse.store(false, std::memory_order_release);
+    }
+};
+
+std::mutex PalBinLog::sRingsMutex;
+std::vector<PalBinLog::Ring *> PalBinLog::sRings;
+
+PalBinLog::Ring *PalBinLog::threadRing()
+{
+    static thread_local ThreadRing tr;
+
+    if (tr.ring || tr.failed)
+        return tr.ring;
+
+    std::lock_guard<std::mutex> lck(sRingsMutex);
+    for (Ring *ring : sRings) {
+        if (!ring->inUse.load(std::memory_order_acquire)) {
+            tr.ring = ring;
+            break;
+        }
+    }
+    if (!tr.ring && sRings.size() < PAL_BINLOG_MAX_RINGS) {
+        tr.ring = new (std::nothrow) Ring();
+        if (tr.ring)
+            sRings.push_back(tr.ring);
+    }
+    if (!tr.ring) {
+        // PAL_* would recurse into here
+        ALOGW("%s: no log ring left, thread logs to logd", __func__);
+        tr.failed = true;
+        return nullptr;
+    }
+
+    tr.ring->inUse.store(true, std::memory_order_relaxed);
+    tr.ring->tid = (int32_t)syscall(SYS_gettid);
+
+    return tr.ring;
+}
+
+/*
+ * Each slot is a seqlock with a single writer, the owning thread. The
+ * sequence is odd while the record is being written, dump() drops records
+ * whose sequence was odd or changed while they were copied.
+ */
+PalBinLog::Slot *PalBinLog::beginSlot()
+{
+    Ring *ring = threadRing();
+    Slot *slot = nullptr;
+    uint32_t seq = 0;
+
+    if (!ring)
+        return nullptr;
+
+    slot = &ring->slots[ring->head % PAL_BINLOG_RING_SLOTS];
+    seq = slot->seq.load(std::memory_order_relaxed);
+    slot->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    return slot;
+}
+
+void PalBinLog::endSlot(Slot *slot)
+{
+    Ring *ring = threadRing();
+
+    slot->seq.store(slot->seq.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+    ring->head++;
+}
+
+void PalBinLog::fillHeader(Record *rec, uint32_t level, const char *tag,
+                           const char *func, int line, const char *fmt)
+{
+    Ring *ring = threadRing();
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    rec->tsNs = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    rec->tag = tag;
+    rec->fmt = fmt;
+    rec->func = func;
+    rec->tid = ring ? ring->tid : 0;
+    rec->line = (uint16_t)line;
+    rec->level = (uint8_t)level;
+    rec->nargs = 0;
+    rec->strUsed = 0;
+}
+
+void PalBinLog::putArg(Record *rec, ArgType type, uint64_t val)
+{
+    if (rec->nargs >= PAL_BINLOG_MAX_ARGS)
+        return;
+
+    rec->types[rec->nargs] = type;
+    rec->args[rec->nargs] = val;
+    rec->nargs++;
+}
+
+void PalBinLog::putStr(Record *rec, const char *s)
+{
+    size_t avail = PAL_BINLOG_STR_BYTES - rec->strUsed;
+    size_t len = 0;
+
+    if (!s) {
+        putArg(rec, ARG_PTR, 0);
+        return;
+    }
+
+    // out of space, point at the terminator of the last copied string
+    if (avail == 0) {
+        putArg(rec, ARG_STR, PAL_BINLOG_STR_BYTES - 1);
+        return;
+    }
+
+    len = strnlen(s, avail - 1);
+    memcpy(rec->str + rec->strUsed, s, len);
+    rec->str[rec->strUsed + len] = '\0';
+    putArg(rec, ARG_STR, rec->strUsed);
+    rec->strUsed += len + 1;
+}
+
+static bool nextArg(const PalBinLog::Record *rec, uint8_t *idx,
+                    uint8_t *type, uint64_t *val)
+{
+    if (*idx >= rec->nargs)
+        return false;
+
+    *type = rec->types[*idx];
+    *val = rec->args[*idx];
+    (*idx)++;
+
+    return true;
+}
+
+size_t PalBinLog::format(const Record *rec, char *buf, size_t size)
+{
+    const char *p = rec->fmt;
+    size_t len = 0;
+    uint8_t idx = 0;
+    uint8_t type = 0;
+    uint64_t val = 0;
+    char spec[32];
+    size_t n = 0;
+    int width = 0;
+    int shortness = 0;
+    bool wide = false;
+    int ret = 0;
+
+    if (!buf || size == 0)
+        return 0;
+
+    buf[0] = '\0';
+    if (!p)
+        return 0;
+
+    while (*p && len < size - 1) {
+        if (*p != '%') {
+            buf[len++] = *p++;
+            continue;
+        }
+        if (p[1] == '%') {
+            buf[len++] = '%';
+            p += 2;
+            continue;
+        }
+
+        n = 0;
+        shortness = 0;
+        wide = false;
+        spec[n++] = *p++;
+        while (*p && strchr("-+ #0", *p) && n < sizeof(spec) - 24)
+            spec[n++] = *p++;
+
+        // width and precision, '*' takes its value from the arguments
+        for (int part = 0; part < 2; part++) {
+            if (part == 1) {
+                if (*p != '.')
+                    break;
+                spec[n++] = *p++;
+            }
+            if (*p == '*') {
+                p++;
+                width = nextArg(rec, &idx, &type, &val) ? (int)(int64_t)val : 0;
+                n += snprintf(spec + n, 12, "%d", width);
+            } else {
+                while (*p >= '0' && *p <= '9' && n < sizeof(spec) - 16)
+                    spec[n++] = *p++;
+            }
+        }
+
+        // length modifiers are dropped, arguments are stored 64 bit wide
+        while (*p && strchr("hljztLq", *p)) {
+            if (*p == 'h')
+                shortness++;
+            else if (*p != 'L')
+                wide = true;
+            p++;
+        }
+
+        if (!*p)
+            break;
+
+        if (*p == 'n') {
+            nextArg(rec, &idx, &type, &val);
+            p++;
+            continue;
+        }
+
+        if (!strchr("diouxXcfFeEgGaAsp", *p)) {
+            // unknown conversion, copy it verbatim
+            spec[n] = '\0';
+            ret = snprintf(buf + len, size - len, "%s%c", spec, *p++);
+            goto advance;
+        }
+
+        if (!nextArg(rec, &idx, &type, &val)) {
+            ret = snprintf(buf + len, size - len, "<?>");
+            p++;
+            goto advance;
+        }
+
+        switch (*p) {
+        case 'd':
+        case 'i':
+            if (!wide)
+                val = shortness == 2 ? (int64_t)(int8_t)val :
+                      shortness == 1 ? (int64_t)(int16_t)val : (int64_t)(int32_t)val;
+            spec[n++] = 'l';
+            spec[n++] = 'l';
+            spec[n++] = *p;
+            spec[n] = '\0';
+            ret = snprintf(buf + len, size - len, spec, (long long)val);
+            break;
+        case 'o':
+        case 'u':
+        case 'x':
+        case 'X':
+            if (!wide)
+                val = shortness == 2 ? (uint8_t)val :
+                      shortness == 1 ? (uint16_t)val : (uint32_t)val;
+            spec[n++] = 'l';
+            spec[n++] = 'l';
+            spec[n++] = *p;
+            spec[n] = '\0';
+            ret = snprintf(buf + len, size - len, spec, (unsigned long long)val);
+            break;
+        case 'c':
+            spec[n++] = 'c';
+            spec[n] = '\0';
+            ret = snprintf(buf + len, size - len, spec, (int)val);
+            break;
+        case 's':
+            spec[n++] = 's';
+            spec[n] = '\0';
+            if (type == ARG_STR && val < PAL_BINLOG_STR_BYTES)
+                ret = snprintf(buf + len, size - len, spec, rec->str + val);
+            else if (type == ARG_PTR && val == 0)
+                ret = snprintf(buf + len, size - len, spec, "(null)");
+            else
+                ret = snprintf(buf + len, size - len, "<%#llx>", (unsigned long long)val);
+            break;
+        case 'p':
+            spec[n++] = 'p';
+            spec[n] = '\0';
+            ret = snprintf(buf + len, size - len, spec, (void *)(uintptr_t)val);
+            break;
+        default: {
+            double d = 0;
+
+            if (type == ARG_DOUBLE)
+                memcpy(&d, &val, sizeof(d));
+            else
+                d = type == ARG_INT ? (double)(int64_t)val : (double)val;
+            spec[n++] = *p;
+            spec[n] = '\0';
+            ret = snprintf(buf + len, size - len, spec, d);
+            break;
+        }
+        }
+        p++;
+
+advance:
+        if (ret < 0)
+            break;
+        len += std::min((size_t)ret, size - len - 1);
+    }
+    buf[len] = '\0';
+
+    return len;
+}
+
+static char levelChar(uint8_t level)
+{
+    switch (level) {
+    case PAL_LOG_ERR:
+        return 'E';
+    case PAL_LOG_INFO:
+        return 'I';
+    case PAL_LOG_DBG:
+        return 'D';
+    default:
+        return 'V';
+    }
+}
+
+int PalBinLog::dump(const char *dir)
+{
+    std::vector<Record> records;
+    Record rec;
+    uint32_t seq = 0;
+    char msg[1024];
+    char path[256];
+    char stamp[32];
+    struct tm tm;
+    time_t sec;
+    FILE *fp = NULL;
+    int fd = -1;
+    int ret = 0;
+
+    {
+        std::lock_guard<std::mutex> lck(sRingsMutex);
+        records.reserve(sRings.size() * PAL_BINLOG_RING_SLOTS);
+        for (Ring *ring : sRings) {
+            for (Slot &slot : ring->slots) {
+                seq = slot.seq.load(std::memory_order_acquire);
+                if (seq == 0 || (seq & 1))
+                    continue;
+                memcpy(&rec, &slot.rec, sizeof(rec));
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) != seq)
+                    continue;
+                records.push_back(rec);
+            }
+        }
+    }
+
+    std::sort(records.begin(), records.end(),
+              [](const Record &a, const Record &b) { return a.tsNs < b.tsNs; });
+
+    sec = time(NULL);
+    localtime_r(&sec, &tm);
+    strftime(stamp, sizeof(stamp), "%Y_%m_%d_%H_%M_%S", &tm);
+    snprintf(path, sizeof(path), "%s/pal_binlog_%s.txt", dir, stamp);
+
+    // never follow or reuse an existing file
+    fd = open(path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0640);
+    if (fd < 0 || !(fp = fdopen(fd, "w"))) {
+        ret = -errno;
+        PAL_ERR(LOG_TAG, "failed to open %s, errno %d", path, errno);
+        if (fd >= 0)
+            close(fd);
+        return ret;
+    }
+
+    for (const Record &r : records) {
+        sec = (time_t)(r.tsNs / 1000000000ULL);
+        localtime_r(&sec, &tm);
+        format(&r, msg, sizeof(msg));
+        fprintf(fp, "%02d-%02d %02d:%02d:%02d.%03u %5d %c %s: %s: %u: %s\n",
+                tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+                (unsigned)((r.tsNs / 1000000ULL) % 1000), r.tid, levelChar(r.level),
+                r.tag ? r.tag : "", r.func ? r.func : "", r.line, msg);
+    }
+    fclose(fp);
+    PAL_INFO(LOG_TAG, "dumped %zu records to %s", records.size(), path);
+
+    return (int)records.size();
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#define LOG_TAG "PAL: PalBufferTuner"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <cstdlib>
+#include "PalCommon.h"
+#include "PalDefs.h"
+#include "PalBufferTuner.h"
+
+// transfers below this are too few to judge a run by
+#define TUNER_MIN_TRANSFERS 32
+// clean runs needed before the period shrinks again
+#define TUNER_SHRINK_RUNS 2
+
+std::mutex PalBufferTuner::sMutex;
+std::map<uint32_t, PalBufferTuner::Bounds> PalBufferTuner::sBounds;
+
+static int64_t nowUs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+int PalBufferTuner::parse(const char **attr)
+{
+    uint32_t streamType = 0;
+    bool hasStream = false;
+    Bounds bounds = {};
+
+    for (int i = 0; attr[i] && attr[i + 1]; i += 2) {
+        if (!strcmp(attr[i], "stream")) {
+            auto it = usecaseIdLUT.find(attr[i + 1]);
+            if (it == usecaseIdLUT.end()) {
+                PAL_ERR(LOG_TAG, "unknown stream %s", attr[i + 1]);
+                return -EINVAL;
+            }
+            streamType = it->second;
+            hasStream = true;
+        } else if (!strcmp(attr[i], "min_period_ms")) {
+            bounds.minMs = atoi(attr[i + 1]);
+        } else if (!strcmp(attr[i], "max_period_ms")) {
+            bounds.maxMs = atoi(attr[i + 1]);
+        }
+    }
+
+    if (!hasStream || bounds.minMs == 0 || bounds.maxMs < bounds.minMs) {
+        PAL_ERR(LOG_TAG, "invalid adaptive_buffer, stream %d min %u max %u",
+                hasStream, bounds.minMs, bounds.maxMs);
+        return -EINVAL;
+    }
+
+    std::lock_guard<std::mutex> lck(sMutex);
+    sBounds[streamType] = bounds;
+    PAL_DBG(LOG_TAG, "stream %u: period %u-%u ms", streamType, bounds.minMs,
+            bounds.maxMs);
+
+    return 0;
+}
+
+size_t PalBufferTuner::clampFrames(size_t frames) const
+{
+    size_t msFrames = mRate / 1000;
+
+    if (!msFrames)
+        return frames;
+
+    frames = ((frames + msFrames - 1) / msFrames) * msFrames;
+    return std::min(std::max(frames, (size_t)mBounds.minMs * msFrames),
+                    (size_t)mBounds.maxMs * msFrames);
+}
+
+size_t PalBufferTuner::start(uint32_t streamType, uint32_t rate, size_t requestedFrames,
+                             size_t periodCount)
+{
+    std::lock_guard<std::mutex> lck(mMutex);
+
+    {
+        std::lock_guard<std::mutex> lock(sMutex);
+        auto it = sBounds.find(streamType);
+        if (it == sBounds.end() || !rate || !requestedFrames) {
+            mActive = false;
+            return requestedFrames;
+        }
+        mBounds = it->second;
+    }
+
+    // a new client config starts over from what the client asked for
+    if (!mPeriod || rate != mRate || requestedFrames != mRequested) {
+        mRate = rate;
+        mRequested = requestedFrames;
+        mPeriod = clampFrames(requestedFrames);
+        mCleanRuns = 0;
+    } else if (mNextPeriod) {
+        mPeriod = mNextPeriod;
+    }
+    mNextPeriod = 0;
+    mCount = periodCount ? periodCount : 1;
+
+    mStartUs = nowUs();
+    mLastUs = 0;
+    mLastFrames = 0;
+    mTransfers = 0;
+    mXruns = 0;
+    mFrames = 0;
+    mJitterUs = 0;
+    mActive = true;
+
+    PAL_DBG(LOG_TAG, "stream %u: period %zu frames x %zu, requested %zu", streamType,
+            mPeriod, mCount, requestedFrames);
+
+    return mPeriod;
+}
+
+void PalBufferTuner::onTransfer(size_t frames)
+{
+    std::lock_guard<std::mutex> lck(mMutex);
+    int64_t now = 0;
+    int64_t intervalUs = 0;
+    int64_t expectedUs = 0;
+    int64_t periodUs = 0;
+    int64_t bufferedUs = 0;
+
+    if (!mActive)
+        return;
+
+    now = nowUs();
+    if (mLastUs) {
+        intervalUs = now - mLastUs;
+        expectedUs = (int64_t)mLastFrames * 1000000LL / mRate;
+        periodUs = (int64_t)mPeriod * 1000000LL / mRate;
+        bufferedUs = periodUs * (int64_t)mCount;
+
+        // the buffer was full or empty when the last call returned
+        if (intervalUs > std::max(expectedUs, bufferedUs) + periodUs)
+            mXruns++;
+        mJitterUs += (std::abs(intervalUs - expectedUs) - mJitterUs) / 8;
+    }
+
+    mLastUs = now;
+    mLastFrames = frames;
+    mFrames += frames;
+    mTransfers++;
+}
+
+void PalBufferTuner::stop()
+{
+    std::lock_guard<std::mutex> lck(mMutex);
+    int64_t periodUs = 0;
+    int64_t elapsedUs = 0;
+    size_t avgFrames = 0;
+    size_t next = 0;
+
+    if (!mActive)
+        return;
+
+    mActive = false;
+    if (mTransfers < TUNER_MIN_TRANSFERS)
+        return;
+
+    periodUs = (int64_t)mPeriod * 1000000LL / mRate;
+    elapsedUs = std::max(nowUs() - mStartUs, (int64_t)1);
+    avgFrames = (size_t)(mFrames / mTransfers);
+    next = mPeriod;
+
+    if (mXruns || mJitterUs > periodUs / 2) {
+        next = clampFrames(mPeriod * 2);
+        mCleanRuns = 0;
+    } else if (avgFrames >= mPeriod * 2) {
+        next = clampFrames(avgFrames);
+        mCleanRuns = 0;
+    } else if (mJitterUs < periodUs / 4 && avgFrames < mPeriod &&
+               ++mCleanRuns >= TUNER_SHRINK_RUNS) {
+        next = clampFrames(std::max(mPeriod / 2, avgFrames));
+        mCleanRuns = 0;
+    }
+
+    PAL_INFO(LOG_TAG, "period %zu -> %zu frames: %u transfers of %zu frames, %lld/s, "
+             "%u xruns, jitter %lld us", mPeriod, next, mTransfers, avgFrames,
+             (long long)((int64_t)mTransfers * 1000000LL / elapsedUs), mXruns,
+             (long long)mJitterUs);
+
+    mNextPeriod = next;
+}
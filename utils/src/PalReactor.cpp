@@ -0,0 +1,364 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#define LOG_TAG "PAL: PalReactor"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "PalCommon.h"
+#include "PalReactor.h"
+
+#define PAL_REACTOR_WORKERS 2
+#define PAL_REACTOR_MAX_EVENTS 8
+
+std::shared_ptr<PalReactor> PalReactor::sInstance = nullptr;
+
+std::shared_ptr<PalReactor> PalReactor::getInstance()
+{
+    static std::mutex instanceMutex;
+    std::lock_guard<std::mutex> lck(instanceMutex);
+
+    if (!sInstance)
+        sInstance = std::make_shared<PalReactor>();
+
+    return sInstance;
+}
+
+PalReactor::PalReactor() :
+    mEpollFd(-1),
+    mEventFd(-1),
+    mTimerFd(-1),
+    mExit(false),
+    mNextTimerId(1)
+{
+    struct epoll_event ev;
+
+    mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+    mEventFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    mTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    if (mEpollFd < 0 || mEventFd < 0 || mTimerFd < 0) {
+        PAL_ERR(LOG_TAG, "failed to create reactor fds, errno %d", errno);
+        // nothing would ever run a task, refuse them
+        mExit = true;
+        return;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = mEventFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mEventFd, &ev);
+    ev.data.fd = mTimerFd;
+    epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mTimerFd, &ev);
+
+    for (int i = 0; i < PAL_REACTOR_WORKERS; i++) {
+        mWorkers.emplace_back(&PalReactor::workerLoop, this, false);
+        mWorkerIds.insert(mWorkers.back().get_id());
+    }
+    mBlockingWorker = std::thread(&PalReactor::workerLoop, this, true);
+    mWorkerIds.insert(mBlockingWorker.get_id());
+    mLoopThread = std::thread(&PalReactor::loop, this);
+    PAL_INFO(LOG_TAG, "reactor started with %d workers", PAL_REACTOR_WORKERS);
+}
+
+PalReactor::~PalReactor()
+{
+    {
+        std::lock_guard<std::mutex> lck(mMutex);
+        mExit = true;
+        mTaskCV.notify_all();
+        mBlockingCV.notify_all();
+    }
+    wakeup();
+
+    if (mLoopThread.joinable())
+        mLoopThread.join();
+    for (auto &worker : mWorkers) {
+        if (worker.joinable())
+            worker.join();
+    }
+    if (mBlockingWorker.joinable())
+        mBlockingWorker.join();
+
+    if (mTimerFd >= 0)
+        close(mTimerFd);
+    if (mEventFd >= 0)
+        close(mEventFd);
+    if (mEpollFd >= 0)
+        close(mEpollFd);
+}
+
+bool PalReactor::isWorkerThread()
+{
+    return mWorkerIds.count(std::this_thread::get_id()) != 0;
+}
+
+void PalReactor::wakeup()
+{
+    uint64_t val = 1;
+
+    if (mEventFd >= 0 && write(mEventFd, &val, sizeof(val)) < 0)
+        PAL_ERR(LOG_TAG, "failed to signal reactor, errno %d", errno);
+}
+
+int PalReactor::addFd(int fd, uint32_t events, FdHandler handler)
+{
+    struct epoll_event ev;
+
+    if (fd < 0 || !handler)
+        return -EINVAL;
+
+    std::lock_guard<std::mutex> lck(mMutex);
+    if (mExit)
+        return -EPIPE;
+    if (mFds.count(fd)) {
+        PAL_ERR(LOG_TAG, "fd %d already registered", fd);
+        return -EEXIST;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events | EPOLLONESHOT;
+    ev.data.fd = fd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        PAL_ERR(LOG_TAG, "failed to add fd %d, errno %d", fd, errno);
+        return -errno;
+    }
+    mFds[fd] = {handler, events, false};
+
+    return 0;
+}
+
+int PalReactor::removeFd(int fd)
+{
+    std::unique_lock<std::mutex> lck(mMutex);
+    auto it = mFds.find(fd);
+
+    if (it == mFds.end())
+        return -EINVAL;
+
+    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, NULL);
+    if (!isWorkerThread()) {
+        mIdleCV.wait(lck, [&] {
+            auto cur = mFds.find(fd);
+            return cur == mFds.end() || !cur->second.running;
+        });
+    }
+    mFds.erase(fd);
+
+    return 0;
+}
+
+int PalReactor::post(Task task)
+{
+    if (!task)
+        return -EINVAL;
+
+    std::lock_guard<std::mutex> lck(mMutex);
+    if (mExit)
+        return -EPIPE;
+    enqueue_l(std::move(task));
+
+    return 0;
+}
+
+PalReactor::TimerId PalReactor::postDelayed(uint32_t delayMs, Task task, bool blocking)
+{
+    TimerId id = 0;
+    Timer timer;
+
+    if (!task)
+        return 0;
+
+    std::lock_guard<std::mutex> lck(mMutex);
+    if (mExit)
+        return 0;
+
+    id = mNextTimerId++;
+    timer.deadline = std::chrono::steady_clock::now() +
+                     std::chrono::milliseconds(delayMs);
+    timer.task = std::move(task);
+    timer.blocking = blocking;
+    mTimerQueue.insert(std::make_pair(timer.deadline, id));
+    mTimers[id] = std::move(timer);
+    armTimerFd_l();
+
+    return id;
+}
+
+bool PalReactor::cancel(TimerId id)
+{
+    std::lock_guard<std::mutex> lck(mMutex);
+    auto it = mTimers.find(id);
+
+    if (it == mTimers.end())
+        return false;
+
+    auto range = mTimerQueue.equal_range(it->second.deadline);
+    for (auto q = range.first; q != range.second; ++q) {
+        if (q->second == id) {
+            mTimerQueue.erase(q);
+            break;
+        }
+    }
+    mTimers.erase(it);
+    armTimerFd_l();
+
+    return true;
+}
+
+bool PalReactor::cancelSync(TimerId id)
+{
+    if (cancel(id))
+        return true;
+
+    if (isWorkerThread())
+        return false;
+
+    std::unique_lock<std::mutex> lck(mMutex);
+    mIdleCV.wait(lck, [&] { return mRunningTimers.count(id) == 0; });
+
+    return false;
+}
+
+void PalReactor::enqueue_l(Task task, bool blocking)
+{
+    if (blocking) {
+        mBlockingTasks.push_back(std::move(task));
+        mBlockingCV.notify_one();
+    } else {
+        mTasks.push_back(std::move(task));
+        mTaskCV.notify_one();
+    }
+}
+
+void PalReactor::armTimerFd_l()
+{
+    struct itimerspec spec;
+    int64_t ns = 0;
+
+    memset(&spec, 0, sizeof(spec));
+    if (!mTimerQueue.empty()) {
+        ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                mTimerQueue.begin()->first - std::chrono::steady_clock::now()).count();
+        // a zero it_value disarms the timer, fire an overdue one right away
+        if (ns <= 0)
+            ns = 1;
+        spec.it_value.tv_sec = ns / 1000000000LL;
+        spec.it_value.tv_nsec = ns % 1000000000LL;
+    }
+
+    if (timerfd_settime(mTimerFd, 0, &spec, NULL) < 0)
+        PAL_ERR(LOG_TAG, "failed to arm timerfd, errno %d", errno);
+}
+
+void PalReactor::expireTimers_l()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+    while (!mTimerQueue.empty() && mTimerQueue.begin()->first <= now) {
+        TimerId id = mTimerQueue.begin()->second;
+        auto it = mTimers.find(id);
+
+        mTimerQueue.erase(mTimerQueue.begin());
+        if (it == mTimers.end())
+            continue;
+
+        Task task = std::move(it->second.task);
+        bool blocking = it->second.blocking;
+        mTimers.erase(it);
+        mRunningTimers.insert(id);
+        enqueue_l([this, id, task]() {
+            task();
+            std::lock_guard<std::mutex> lck(mMutex);
+            mRunningTimers.erase(id);
+            mIdleCV.notify_all();
+        }, blocking);
+    }
+}
+
+void PalReactor::dispatchFd_l(int fd, uint32_t events)
+{
+    auto it = mFds.find(fd);
+
+    if (it == mFds.end())
+        return;
+
+    FdHandler handler = it->second.handler;
+    it->second.running = true;
+    enqueue_l([this, fd, events, handler]() {
+        struct epoll_event ev;
+
+        handler(events);
+
+        std::lock_guard<std::mutex> lck(mMutex);
+        auto cur = mFds.find(fd);
+        if (cur != mFds.end()) {
+            cur->second.running = false;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = cur->second.events | EPOLLONESHOT;
+            ev.data.fd = fd;
+            epoll_ctl(mEpollFd, EPOLL_CTL_MOD, fd, &ev);
+        }
+        mIdleCV.notify_all();
+    });
+}
+
+void PalReactor::loop()
+{
+    struct epoll_event events[PAL_REACTOR_MAX_EVENTS];
+    uint64_t val = 0;
+    int n = 0;
+
+    PAL_DBG(LOG_TAG, "Enter");
+    while (true) {
+        n = epoll_wait(mEpollFd, events, PAL_REACTOR_MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            PAL_ERR(LOG_TAG, "epoll_wait failed, errno %d", errno);
+            break;
+        }
+
+        std::lock_guard<std::mutex> lck(mMutex);
+        if (mExit)
+            break;
+
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.fd == mEventFd) {
+                if (read(mEventFd, &val, sizeof(val)) < 0)
+                    PAL_VERBOSE(LOG_TAG, "eventfd read failed, errno %d", errno);
+            } else if (events[i].data.fd == mTimerFd) {
+                if (read(mTimerFd, &val, sizeof(val)) < 0)
+                    PAL_VERBOSE(LOG_TAG, "timerfd read failed, errno %d", errno);
+            } else {
+                dispatchFd_l(events[i].data.fd, events[i].events);
+            }
+        }
+        expireTimers_l();
+        armTimerFd_l();
+    }
+    PAL_DBG(LOG_TAG, "Exit");
+}
+
+void PalReactor::workerLoop(bool blocking)
+{
+    std::unique_lock<std::mutex> lck(mMutex);
+    std::deque<Task> &tasks = blocking ? mBlockingTasks : mTasks;
+    std::condition_variable &cv = blocking ? mBlockingCV : mTaskCV;
+
+    while (true) {
+        cv.wait(lck, [&] { return mExit || !tasks.empty(); });
+        if (mExit)
+            break;
+
+        Task task = std::move(tasks.front());
+        tasks.pop_front();
+        lck.unlock();
+        task();
+        lck.lock();
+    }
+}
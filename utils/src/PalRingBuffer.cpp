@@ -37,10 +37,116 @@
 #ifdef LINUX_ENABLED
 #include <algorithm>
 #endif
+#include <new>
+#include <time.h>
 #include "PalRingBuffer.h"
 #include "PalCommon.h"
 #include "StreamSoundTrigger.h"
 
+std::mutex PalRingBufferPool::mutex_;
+std::vector<PalRingBufferPool::IdleBlock> PalRingBufferPool::idle_;
+PalRingBufferPool::Stats PalRingBufferPool::stats_ = {};
+PalReactor::TimerId PalRingBufferPool::trimTimer_ = 0;
+
+static int64_t nowMs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+char* PalRingBufferPool::acquire(size_t size, size_t *capacity)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    auto best = idle_.end();
+    char *block = nullptr;
+
+    // smallest cached block which fits, at most twice the requested size
+    for (auto it = idle_.begin(); it != idle_.end(); it++) {
+        if (it->capacity >= size && it->capacity <= size * 2 &&
+            (best == idle_.end() || it->capacity < best->capacity))
+            best = it;
+    }
+
+    if (best != idle_.end()) {
+        block = best->block;
+        *capacity = best->capacity;
+        stats_.idleBytes -= best->capacity;
+        idle_.erase(best);
+        stats_.reuses++;
+    } else {
+        block = new (std::nothrow) char[size];
+        if (!block)
+            return nullptr;
+        *capacity = size;
+        stats_.allocs++;
+    }
+    stats_.liveBytes += *capacity;
+    stats_.peakBytes = std::max(stats_.peakBytes, stats_.liveBytes);
+    PAL_DBG(LOG_TAG, "acquired %zu bytes, live %zu idle %zu", *capacity,
+            stats_.liveBytes, stats_.idleBytes);
+
+    return block;
+}
+
+void PalRingBufferPool::release(char *block, size_t capacity)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+
+    stats_.liveBytes -= capacity;
+    if (stats_.idleBytes + capacity > PAL_RING_POOL_MAX_IDLE_BYTES) {
+        delete[] block;
+        return;
+    }
+    idle_.push_back({capacity, block, nowMs()});
+    stats_.idleBytes += capacity;
+
+    if (!trimTimer_)
+        trimTimer_ = PalReactor::getInstance()->postDelayed(
+                PAL_RING_POOL_IDLE_TIMEOUT_MS, [] { trim(); });
+}
+
+/* frees the blocks nobody took back within PAL_RING_POOL_IDLE_TIMEOUT_MS */
+void PalRingBufferPool::trim()
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+    int64_t now = nowMs();
+    int64_t next = INT64_MAX;
+
+    trimTimer_ = 0;
+    for (auto it = idle_.begin(); it != idle_.end();) {
+        if (now - it->releasedMs >= PAL_RING_POOL_IDLE_TIMEOUT_MS) {
+            stats_.idleBytes -= it->capacity;
+            delete[] it->block;
+            it = idle_.erase(it);
+        } else {
+            next = std::min(next, it->releasedMs + PAL_RING_POOL_IDLE_TIMEOUT_MS);
+            ++it;
+        }
+    }
+
+    if (!idle_.empty())
+        trimTimer_ = PalReactor::getInstance()->postDelayed(
+                (uint32_t)std::max(next - now, (int64_t)1), [] { trim(); });
+}
+
+PalRingBufferPool::Stats PalRingBufferPool::getStats()
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+
+    return stats_;
+}
+
+void PalRingBufferPool::dump()
+{
+    Stats stats = getStats();
+
+    PAL_INFO(LOG_TAG, "ring buffers: live %zu peak %zu idle %zu bytes, %u allocs %u reuses",
+             stats.liveBytes, stats.peakBytes, stats.idleBytes, stats.allocs,
+             stats.reuses);
+}
+
 int32_t PalRingBuffer::removeReader(PalRingBufferReader *reader)
 {
     auto iter = std::find(readers_.begin(), readers_.end(), reader);
@@ -134,6 +240,13 @@ size_t PalRingBuffer::write(void* writeBuffer, size_t writeSize)
     size_t sizeToCopy = 0;
 
     std::lock_guard<std::mutex> lck(mutex_);
+    if (!buffer_) {
+        buffer_ = PalRingBufferPool::acquire(bufferEnd_, &capacity_);
+        if (!buffer_) {
+            PAL_ERR(LOG_TAG, "Failed to get %zu bytes of ring storage", bufferEnd_);
+            return 0;
+        }
+    }
     freeSize = getFreeSize();
     PAL_DBG(LOG_TAG, "Enter. freeSize(%zu), writeOffset(%zu)", freeSize, writeOffset_);
 
@@ -174,6 +287,7 @@ void PalRingBuffer::reset()
     mutex_.lock();
     kwCfg_.clear();
     writeOffset_ = 0;
+    releaseStorage_l();
     mutex_.unlock();
 
     /* Reset all the associated readers */
@@ -181,13 +295,20 @@ void PalRingBuffer::reset()
         (*(it))->reset();
 }
 
-void PalRingBuffer::resizeRingBuffer(size_t bufferSize)
+void PalRingBuffer::releaseStorage_l()
 {
     if (buffer_) {
-        delete[] buffer_;
+        PalRingBufferPool::release(buffer_, capacity_);
         buffer_ = nullptr;
+        capacity_ = 0;
     }
-    buffer_ = (char *)new char[bufferSize];
+}
+
+void PalRingBuffer::resizeRingBuffer(size_t bufferSize)
+{
+    std::lock_guard<std::mutex> lck(mutex_);
+
+    releaseStorage_l();
     bufferEnd_ = bufferSize;
 }
 
@@ -219,7 +340,7 @@ int32_t PalRingBufferReader::read(void* readBuffer, size_t bufferSize)
     }
 
     // Return 0 when no data can be read for current reader
-    if (unreadSize_ == 0)
+    if (unreadSize_ == 0 || !ringBuffer_->buffer_)
         return 0;
 
 
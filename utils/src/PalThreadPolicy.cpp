@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#define LOG_TAG "PAL: PalThreadPolicy"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include "PalCommon.h"
+#include "PalThreadPolicy.h"
+
+#define PAL_THREAD_MAX_CPUS 64
+
+std::mutex PalThreadPolicy::sMutex;
+std::map<std::string, PalThreadPolicy::Policy> PalThreadPolicy::sPolicies;
+std::map<std::string, PalThreadPolicy::Applied> PalThreadPolicy::sApplied;
+
+// "0-3,6" style list, as in /sys/devices/system/cpu/online
+int PalThreadPolicy::parseCpus(const char *str, uint64_t *cpus)
+{
+    char *end = NULL;
+    long first = 0;
+    long last = 0;
+
+    *cpus = 0;
+    while (*str) {
+        first = strtol(str, &end, 10);
+        if (end == str)
+            return -EINVAL;
+        last = first;
+        if (*end == '-') {
+            str = end + 1;
+            last = strtol(str, &end, 10);
+            if (end == str)
+                return -EINVAL;
+        }
+        if (first < 0 || last < first || last >= PAL_THREAD_MAX_CPUS)
+            return -EINVAL;
+        for (long cpu = first; cpu <= last; cpu++)
+            *cpus |= 1ULL << cpu;
+
+        str = end;
+        while (*str == ',' || *str == ' ')
+            str++;
+    }
+
+    return *cpus ? 0 : -EINVAL;
+}
+
+int PalThreadPolicy::parse(const char **attr)
+{
+    std::string name;
+    Policy policy;
+
+    for (int i = 0; attr[i] && attr[i + 1]; i += 2) {
+        if (!strcmp(attr[i], "name")) {
+            name = attr[i + 1];
+        } else if (!strcmp(attr[i], "sched")) {
+            if (!strcmp(attr[i + 1], "SCHED_FIFO")) {
+                policy.sched = SCHED_FIFO;
+            } else if (!strcmp(attr[i + 1], "SCHED_OTHER")) {
+                policy.sched = SCHED_OTHER;
+            } else {
+                PAL_ERR(LOG_TAG, "unsupported sched %s", attr[i + 1]);
+                return -EINVAL;
+            }
+        } else if (!strcmp(attr[i], "priority")) {
+            policy.priority = atoi(attr[i + 1]);
+        } else if (!strcmp(attr[i], "nice")) {
+            policy.nice = atoi(attr[i + 1]);
+            policy.setNice = true;
+        } else if (!strcmp(attr[i], "cpus")) {
+            if (parseCpus(attr[i + 1], &policy.cpus)) {
+                PAL_ERR(LOG_TAG, "invalid cpus %s", attr[i + 1]);
+                return -EINVAL;
+            }
+        } else if (!strcmp(attr[i], "cpuset")) {
+            policy.cpuset = attr[i + 1];
+        }
+    }
+
+    if (name.empty()) {
+        PAL_ERR(LOG_TAG, "thread_policy without name");
+        return -EINVAL;
+    }
+
+    if (policy.sched == SCHED_FIFO &&
+        (policy.priority < sched_get_priority_min(SCHED_FIFO) ||
+         policy.priority > sched_get_priority_max(SCHED_FIFO))) {
+        PAL_ERR(LOG_TAG, "invalid SCHED_FIFO priority %d for %s",
+                policy.priority, name.c_str());
+        return -EINVAL;
+    }
+
+    std::lock_guard<std::mutex> lck(sMutex);
+    sPolicies[name] = policy;
+    PAL_DBG(LOG_TAG, "%s: sched %d prio %d nice %d cpus %#llx cpuset %s", name.c_str(),
+            policy.sched, policy.priority, policy.setNice ? policy.nice : 0,
+            (unsigned long long)policy.cpus, policy.cpuset.c_str());
+
+    return 0;
+}
+
+/*
+ * All calls below act on the calling thread. A failing step is logged and
+ * the remaining ones are still applied, the first error is returned.
+ */
+int PalThreadPolicy::apply(const char *name)
+{
+    Policy policy;
+    struct sched_param param;
+    cpu_set_t cpuset;
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    std::string path;
+    char buf[16];
+    int status = 0;
+    int fd = -1;
+    int len = 0;
+
+    pthread_setname_np(pthread_self(), name);
+
+    {
+        std::lock_guard<std::mutex> lck(sMutex);
+        auto it = sPolicies.find(name);
+        if (it == sPolicies.end())
+            return 0;
+        policy = it->second;
+    }
+
+    if (policy.sched >= 0) {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = policy.sched == SCHED_FIFO ? policy.priority : 0;
+        if (sched_setscheduler(0, policy.sched, &param)) {
+            status = status ? status : -errno;
+            PAL_ERR(LOG_TAG, "%s: sched_setscheduler failed, errno %d", name, errno);
+        }
+    }
+
+    if (policy.setNice && setpriority(PRIO_PROCESS, 0, policy.nice)) {
+        status = status ? status : -errno;
+        PAL_ERR(LOG_TAG, "%s: setpriority failed, errno %d", name, errno);
+    }
+
+    if (policy.cpus) {
+        CPU_ZERO(&cpuset);
+        for (int cpu = 0; cpu < PAL_THREAD_MAX_CPUS; cpu++) {
+            if (policy.cpus & (1ULL << cpu))
+                CPU_SET(cpu, &cpuset);
+        }
+        if (sched_setaffinity(0, sizeof(cpuset), &cpuset)) {
+            status = status ? status : -errno;
+            PAL_ERR(LOG_TAG, "%s: sched_setaffinity failed, errno %d", name, errno);
+        }
+    }
+
+    if (!policy.cpuset.empty()) {
+        path = "/dev/cpuset/" + policy.cpuset + "/tasks";
+        fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+        len = snprintf(buf, sizeof(buf), "%d", tid);
+        if (fd < 0 || write(fd, buf, len) != len) {
+            status = status ? status : -errno;
+            PAL_ERR(LOG_TAG, "%s: failed to join %s, errno %d", name, path.c_str(), errno);
+        }
+        if (fd >= 0)
+            close(fd);
+    }
+
+    {
+        std::lock_guard<std::mutex> lck(sMutex);
+        sApplied[name] = {tid, status};
+    }
+    PAL_INFO(LOG_TAG, "%s tid %d: policy applied, status %d", name, tid, status);
+
+    return status;
+}
+
+void PalThreadPolicy::dump()
+{
+    std::lock_guard<std::mutex> lck(sMutex);
+
+    PAL_INFO(LOG_TAG, "%zu thread policies", sPolicies.size());
+    for (auto &entry : sPolicies) {
+        const Policy &policy = entry.second;
+        auto applied = sApplied.find(entry.first);
+
+        PAL_INFO(LOG_TAG, "%s: sched %d prio %d nice %d cpus %#llx cpuset %s, tid %d status %d",
+                 entry.first.c_str(), policy.sched, policy.priority,
+                 policy.setNice ? policy.nice : 0, (unsigned long long)policy.cpus,
+                 policy.cpuset.c_str(),
+                 applied != sApplied.end() ? applied->second.tid : -1,
+                 applied != sApplied.end() ? applied->second.status : 0);
+    }
+}
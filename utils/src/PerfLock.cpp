@@ -10,18 +10,83 @@
 
 #include <sstream>
 
+// every Nth call which would boost runs unboosted to re-measure its cost
+#define PERF_LOCK_EXPLORE_INTERVAL 16
+#define PERF_LOCK_REPORT_INTERVAL 64
+
 PerfLock::PerfLock(const std::string &caller) : mCaller(caller) {
     static bool isInit = init();
     std::scoped_lock lock (sMutex);
-    acquire_l();
+    mStart = std::chrono::steady_clock::now();
+    if (sBudgetUs == 0)
+        acquire_l();
 }
 
 PerfLock::~PerfLock() {
+    uint32_t costUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - mStart).count();
+    std::scoped_lock lock (sMutex);
+
+    if (mTracked)
+        recordCost_l(costUs);
+    if (mHeld)
+        release_l();
+}
+
+void PerfLock::setStreamContext(uint32_t streamType, uint32_t deviceId) {
     std::scoped_lock lock (sMutex);
-    release_l();
+
+    if (sBudgetUs == 0 || mTracked)
+        return;
+
+    mKey = std::make_tuple(mCaller, streamType, deviceId);
+    mTracked = true;
+    mBoosted = shouldBoost_l(sCosts[mKey]);
+    if (mBoosted)
+        acquire_l();
+}
+
+bool PerfLock::shouldBoost_l(CostStats &stats) {
+    // a boosted cost is a lower bound of the unboosted one
+    uint32_t predictedUs = stats.unboostedUs ? stats.unboostedUs : stats.boostedUs;
+
+    // nothing learned yet, boost as without a budget
+    if (predictedUs == 0)
+        return true;
+
+    if (predictedUs <= sBudgetUs)
+        return false;
+
+    if (stats.boostedUs <= sBudgetUs &&
+        stats.calls % PERF_LOCK_EXPLORE_INTERVAL == PERF_LOCK_EXPLORE_INTERVAL - 1)
+        return false;
+
+    return true;
+}
+
+void PerfLock::recordCost_l(uint32_t costUs) {
+    CostStats &stats = sCosts[mKey];
+    uint32_t &avgUs = mBoosted ? stats.boostedUs : stats.unboostedUs;
+
+    if (mBoosted) {
+        stats.boosted++;
+        if (stats.unboostedUs && costUs < stats.unboostedUs)
+            stats.helped++;
+    }
+    avgUs = avgUs ? avgUs - avgUs / 8 + costUs / 8 : costUs;
+    stats.calls++;
+
+    if (stats.calls % PERF_LOCK_REPORT_INTERVAL == 0) {
+        PAL_INFO(LOG_TAG, "%s type %u dev %u: %u calls, %u boosted, %u helped, "
+                 "cost %u us unboosted %u us boosted, budget %u us",
+                 mCaller.c_str(), std::get<1>(mKey), std::get<2>(mKey), stats.calls,
+                 stats.boosted, stats.helped, stats.unboostedUs, stats.boostedUs,
+                 sBudgetUs);
+    }
 }
 
 void PerfLock::acquire_l() {
+    mHeld = true;
     ++sPerfLockCounter;
     if (!sIsAcquired && sAcquirePerfLock != nullptr) {
         sHandle = sAcquirePerfLock(0, 0, kPerfLockOpts.data(), kPerfLockOptsSize);
@@ -35,6 +100,7 @@ void PerfLock::acquire_l() {
 }
 
 void PerfLock::release_l() {
+    mHeld = false;
     --sPerfLockCounter;
     if (sHandle > 0 && sReleasePerfLock != nullptr && (sPerfLockCounter == 0)) {
         sReleasePerfLock(sHandle);
@@ -50,6 +116,7 @@ void PerfLock::setPerfLockOpt(const PerfLockConfig & config) {
         kPerfLockOptsSize = config.perfLockOpts.size();
         kPerfLockOpts = config.perfLockOpts;
         sLibraryName = config.libraryName;
+        sBudgetUs = config.budgetUs;
     }
 }
 
@@ -80,8 +147,8 @@ bool PerfLock::init() {
         hexStream << std::hex << i << " ";
     }
 
-    PAL_INFO(LOG_TAG, "initialized perflock library %s size %d, locks %s", sLibraryName.c_str(),
-        kPerfLockOptsSize, hexStream.str().c_str());
+    PAL_INFO(LOG_TAG, "initialized perflock library %s size %d, locks %s, budget %u us",
+        sLibraryName.c_str(), kPerfLockOptsSize, hexStream.str().c_str(), sBudgetUs);
 
     return true;
 }
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#define LOG_TAG "PAL: SoundModelCache"
+
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include "PalCommon.h"
+#include "SoundModelCache.h"
+
+#define SM_CACHE_IDLE_TIMEOUT_MS 10000
+
+int32_t ReleaseVUIInterface(struct vui_intf_t *intf);
+
+std::shared_ptr<SoundModelCache> SoundModelCache::sInstance = nullptr;
+
+static int64_t nowMs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+std::shared_ptr<SoundModelCache> SoundModelCache::getInstance()
+{
+    static std::mutex instanceMutex;
+    std::lock_guard<std::mutex> lck(instanceMutex);
+
+    if (!sInstance)
+        sInstance = std::make_shared<SoundModelCache>();
+
+    return sInstance;
+}
+
+SoundModelCache::SoundModelCache() :
+    mExpiryTimer(0),
+    mResidentBytes(0),
+    mHits(0),
+    mMisses(0)
+{
+}
+
+SoundModelCache::~SoundModelCache()
+{
+    if (mExpiryTimer)
+        PalReactor::getInstance()->cancelSync(mExpiryTimer);
+
+    std::lock_guard<std::mutex> lck(mMutex);
+    for (auto &it : mEntries)
+        releaseEntry_l(it.first, it.second);
+    mEntries.clear();
+}
+
+void SoundModelCache::MakeKey(const struct pal_st_sound_model *model, Key *key)
+{
+    const uint8_t *data = (const uint8_t *)model;
+    size_t size = (size_t)model->data_offset + model->data_size;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    // covers the phrase header too, which sits between the struct and data
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+
+    memset(key, 0, sizeof(*key));
+    key->vendorUuid = model->vendor_uuid;
+    key->type = model->type;
+    key->dataSize = model->data_size;
+    key->dataOffset = model->data_offset;
+    key->hash = hash;
+}
+
+bool SoundModelCache::Take(void *owner, const Key &key, struct vui_intf_t *intf)
+{
+    std::lock_guard<std::mutex> lck(mMutex);
+    auto it = mEntries.find(owner);
+
+    if (it == mEntries.end()) {
+        mMisses++;
+        return false;
+    }
+
+    if (memcmp(&it->second.key, &key, sizeof(key))) {
+        // the stream loads a different model now
+        releaseEntry_l(owner, it->second);
+        mEntries.erase(it);
+        mMisses++;
+        logStats_l("miss");
+        return false;
+    }
+
+    *intf = it->second.intf;
+    mResidentBytes -= key.dataSize;
+    mEntries.erase(it);
+    mHits++;
+    logStats_l("hit");
+
+    return true;
+}
+
+void SoundModelCache::Park(void *owner, const Key &key, struct vui_intf_t *intf)
+{
+    std::lock_guard<std::mutex> lck(mMutex);
+    auto it = mEntries.find(owner);
+
+    if (!intf->interface)
+        return;
+
+    if (it != mEntries.end()) {
+        releaseEntry_l(owner, it->second);
+        mEntries.erase(it);
+    }
+
+    Entry &entry = mEntries[owner];
+    entry.key = key;
+    entry.intf = *intf;
+    entry.parkedMs = nowMs();
+    intf->interface = nullptr;
+    mResidentBytes += key.dataSize;
+    logStats_l("park");
+
+    if (!mExpiryTimer)
+        mExpiryTimer = PalReactor::getInstance()->postDelayed(SM_CACHE_IDLE_TIMEOUT_MS,
+                                                              [this] { expire(); });
+}
+
+void SoundModelCache::Drop(void *owner)
+{
+    std::lock_guard<std::mutex> lck(mMutex);
+    auto it = mEntries.find(owner);
+
+    if (it == mEntries.end())
+        return;
+
+    releaseEntry_l(owner, it->second);
+    mEntries.erase(it);
+}
+
+void SoundModelCache::GetStats(Stats *stats)
+{
+    if (!stats)
+        return;
+
+    std::lock_guard<std::mutex> lck(mMutex);
+    stats->hits = mHits;
+    stats->misses = mMisses;
+    stats->entries = mEntries.size();
+    stats->residentBytes = mResidentBytes;
+}
+
+void SoundModelCache::expire()
+{
+    std::lock_guard<std::mutex> lck(mMutex);
+    int64_t now = nowMs();
+    int64_t next = INT64_MAX;
+
+    mExpiryTimer = 0;
+    for (auto it = mEntries.begin(); it != mEntries.end();) {
+        if (now - it->second.parkedMs >= SM_CACHE_IDLE_TIMEOUT_MS) {
+            PAL_DBG(LOG_TAG, "release idle model of %pK", it->first);
+            releaseEntry_l(it->first, it->second);
+            it = mEntries.erase(it);
+        } else {
+            next = std::min(next, it->second.parkedMs + SM_CACHE_IDLE_TIMEOUT_MS);
+            ++it;
+        }
+    }
+
+    if (!mEntries.empty())
+        mExpiryTimer = PalReactor::getInstance()->postDelayed(
+                (uint32_t)std::max(next - now, (int64_t)1), [this] { expire(); });
+}
+
+void SoundModelCache::releaseEntry_l(void *owner, Entry &entry)
+{
+    /*
+     * Released with mMutex held, so that a stream which missed in Take()
+     * creates its new interface only after the old one is detached.
+     */
+    mResidentBytes -= entry.key.dataSize;
+    if (entry.intf.interface) {
+        entry.intf.interface->DetachStream(owner);
+        ReleaseVUIInterface(&entry.intf);
+        entry.intf.interface = nullptr;
+    }
+}
+
+void SoundModelCache::logStats_l(const char *op)
+{
+    uint64_t total = mHits + mMisses;
+
+    PAL_DBG(LOG_TAG, "%s: hit rate %llu/%llu (%llu%%), parked %zu, resident %zu bytes",
+            op, (unsigned long long)mHits, (unsigned long long)total,
+            total ? (unsigned long long)(mHits * 100 / total) : 0ULL,
+            mEntries.size(), mResidentBytes);
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2024 Qualcomm Innovation Center, Inc. All rights reserved.
+ * SPDX-License-Identifier: BSD-3-Clause-Clear
+ */
+#define LOG_TAG "PAL: ThermalCalService"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <tinyalsa/asoundlib.h>
+#include "PalCommon.h"
+#include "ThermalCalService.h"
+
+std::shared_ptr<ThermalCalService> ThermalCalService::sInstance = nullptr;
+
+std::shared_ptr<ThermalCalService> ThermalCalService::getInstance()
+{
+    static std::mutex instanceMutex;
+    std::lock_guard<std::mutex> lck(instanceMutex);
+
+    if (!sInstance)
+        sInstance = std::make_shared<ThermalCalService>();
+
+    return sInstance;
+}
+
+ThermalCalService::ThermalCalService()
+{
+}
+
+ThermalCalService::~ThermalCalService()
+{
+}
+
+struct mixer_ctl *ThermalCalService::resolveCtrl_l(struct mixer *mixer,
+                                                   const TempCtrlNames &names)
+{
+    struct mixer_ctl *ctl = nullptr;
+    std::string key;
+
+    for (auto &name : names)
+        key += name + "|";
+
+    auto it = mTempCtrls.find(std::make_pair(mixer, key));
+    if (it != mTempCtrls.end())
+        return it->second;
+
+    for (auto &name : names) {
+        ctl = mixer_get_ctl_by_name(mixer, name.c_str());
+        if (ctl) {
+            PAL_DBG(LOG_TAG, "Using %s for temperature", name.c_str());
+            break;
+        }
+    }
+    if (!ctl) {
+        // may show up once the card is back online, look it up again next time
+        PAL_ERR(LOG_TAG, "Invalid mixer control: %s", key.c_str());
+        return nullptr;
+    }
+
+    mTempCtrls[std::make_pair(mixer, key)] = ctl;
+
+    return ctl;
+}
+
+void ThermalCalService::invalidateMixer(struct mixer *mixer)
+{
+    std::lock_guard<std::mutex> lck(mTempMutex);
+
+    for (auto it = mTempCtrls.begin(); it != mTempCtrls.end();) {
+        if (!mixer || it->first.first == mixer)
+            it = mTempCtrls.erase(it);
+        else
+            ++it;
+    }
+}
+
+int ThermalCalService::readTemperatures(struct mixer *mixer,
+                                        const std::vector<TempCtrlNames> &channels,
+                                        int *temps)
+{
+    std::vector<struct mixer_ctl *> ctls;
+
+    if (!mixer || !temps)
+        return -EINVAL;
+
+    {
+        std::lock_guard<std::mutex> lck(mTempMutex);
+        for (auto &names : channels)
+            ctls.push_back(resolveCtrl_l(mixer, names));
+    }
+
+    for (size_t i = 0; i < ctls.size(); i++) {
+        temps[i] = ctls[i] ? mixer_ctl_get_value(ctls[i], 0) : -EINVAL;
+        PAL_DBG(LOG_TAG, "channel %zu temperature %d", i, temps[i]);
+    }
+
+    return ctls.size();
+}
+
+ThermalCalService::CalData ThermalCalService::getCalData(const std::string &path)
+{
+    struct stat st;
+    CalEntry entry;
+    FILE *fp = NULL;
+    std::shared_ptr<std::vector<uint8_t>> data;
+
+    if (stat(path.c_str(), &st) < 0) {
+        std::lock_guard<std::mutex> lck(mCalMutex);
+        mCalFiles.erase(path);
+        return nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lck(mCalMutex);
+        auto it = mCalFiles.find(path);
+        if (it != mCalFiles.end() && it->second.ino == st.st_ino &&
+            it->second.size == st.st_size &&
+            it->second.mtime.tv_sec == st.st_mtim.tv_sec &&
+            it->second.mtime.tv_nsec == st.st_mtim.tv_nsec)
+            return it->second.data;
+    }
+
+    // read without the lock, readers of other files are not held up
+    fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        PAL_ERR(LOG_TAG, "Unable to open %s, errno %d", path.c_str(), errno);
+        return nullptr;
+    }
+    data = std::make_shared<std::vector<uint8_t>>(st.st_size);
+    if (st.st_size && fread(data->data(), 1, st.st_size, fp) != (size_t)st.st_size) {
+        PAL_ERR(LOG_TAG, "short read of %s", path.c_str());
+        fclose(fp);
+        return nullptr;
+    }
+    fclose(fp);
+    PAL_DBG(LOG_TAG, "loaded %s, %zu bytes", path.c_str(), data->size());
+
+    entry.data = data;
+    entry.ino = st.st_ino;
+    entry.size = st.st_size;
+    entry.mtime = st.st_mtim;
+
+    std::lock_guard<std::mutex> lck(mCalMutex);
+    mCalFiles[path] = entry;
+
+    return entry.data;
+}
+
+void ThermalCalService::invalidate(const std::string &path)
+{
+    std::lock_guard<std::mutex> lck(mCalMutex);
+
+    mCalFiles.erase(path);
+}
+
+bool ThermalCalService::readCal(const CalData &data, size_t *offset, void *dst, size_t size)
+{
+    if (!data || !offset || !dst || *offset + size > data->size())
+        return false;
+
+    memcpy(dst, data->data() + *offset, size);
+    *offset += size;
+
+    return true;
+}